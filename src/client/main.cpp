@@ -22,6 +22,7 @@
 #include <access_table.h>
 #include <api.h>
 #include <config.h>
+#include <cppan_archive.h>
 #include <database.h>
 #include <exceptions.h>
 #include <filesystem.h>
@@ -30,6 +31,7 @@
 #include <printers/cmake.h>
 #include <program.h>
 #include <resolver.h>
+#include <scheduler.h>
 #include <settings.h>
 #include <verifier.h>
 
@@ -37,7 +39,6 @@
 #include <primitives/command.h>
 #include <primitives/pack.h>
 #include <primitives/templates.h>
-#include <primitives/executor.h>
 #ifdef _WIN32
 #include <primitives/win32helpers.h>
 #endif
@@ -69,8 +70,8 @@ void command_init(const Strings &args);
 int main(int argc, char *argv[])
 {
     // globals init
-    Executor e;
-    getExecutor(&e);
+    Scheduler s;
+    getScheduler(&s);
 
     //
 
@@ -393,7 +394,7 @@ int main(int argc, char *argv[])
 
     if (options().count("verify"))
     {
-        verify(options["verify"].as<String>());
+        verify(options["verify"].as<Strings>(), options["verify-full"].as<bool>());
         LOG_INFO(logger, "Verified...  Ok. Packages are the same.");
         return 0;
     }
@@ -453,6 +454,7 @@ int main(int argc, char *argv[])
     auto par = options()["prepare-archive-remote"].as<bool>();
     if (options()["prepare-archive"].as<bool>() || par)
     {
+        auto format = get_archive_format(options()["archive-format"].as<String>());
         path t = ".cppan/temp";
         Config c;
         c.load_current_config();
@@ -485,7 +487,7 @@ int main(int argc, char *argv[])
                 }
             };
             project.findSources();
-            String archive_name = make_archive_name(project.pkg.ppath.toString());
+            String archive_name = make_archive_name(project.pkg.ppath.toString(), format);
             if (!project.writeArchive(fs::absolute(cwd / archive_name)))
                 throw std::runtime_error("Archive write failed");
         }
@@ -724,7 +726,8 @@ std::optional<int> internal(const Strings &args)
 
         path file = trim_double_quotes(args[2]);
         std::istringstream f(read_file(file));
-        auto &e = getExecutor();
+        // child processes are cpu bound, run one per core
+        TaskGroup g(Scheduler::Io, Scheduler::Normal, getScheduler().numberOfThreads(Scheduler::Cpu));
         while (1)
         {
             std::string wd, prog, arg;
@@ -736,9 +739,9 @@ std::optional<int> internal(const Strings &args)
             c.working_directory = wd;
             c.setProgram(prog);
             c.arguments.push_back(arg);
-            e.push([c]() mutable { c.execute(); });
+            g.push([c]() mutable { c.execute(); });
         }
-        e.wait();
+        g.wait();
 
         return 0;
     }
@@ -30,6 +30,7 @@ ProgramOptions::ProgramOptions()
         ("version,V", po::bool_switch(), "version")
         ("prepare-archive", po::bool_switch(), "prepare archive locally")
         ("prepare-archive-remote", po::bool_switch(), "prepare archive from remote source")
+        ("archive-format", po::value<String>()->default_value("tar.gz"), "archive format for prepared archives: tar.gz, tar.zst")
         ("curl-verbose", po::bool_switch(), "set curl to verbose mode")
         ("self-upgrade", po::bool_switch(), "upgrade CPPAN client to the latest version")
         ("ignore-ssl-checks,k", po::bool_switch(), "ignore ssl checks and errors")
@@ -37,7 +38,8 @@ ProgramOptions::ProgramOptions()
         (SERVER_QUERY ",s", po::bool_switch(), "force query server")
 
         ("fetch", po::bool_switch(), "fetch current source")
-        ("verify", po::value<std::string>(), "verify package")
+        ("verify", po::value<Strings>()->multitoken(), "verify packages")
+        ("verify-full", po::bool_switch(), "verify packages by packing and unpacking sources instead of hashing them in place")
 
         ("config", po::value<std::string>()->default_value(""), "config name for building")
         ("generate", po::value<std::string>(), "file or dir: generate project files for inline building")
@@ -0,0 +1,271 @@
+/*
+ * Copyright (C) 2016-2017, Egor Pugin
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "package.h"
+
+#include <bitset>
+#include <cstring>
+#include <map>
+#include <optional>
+#include <set>
+#include <type_traits>
+#include <unordered_map>
+#include <variant>
+
+// Simple binary (de)serialization for caches: io(ar, v) writes v with Writer
+// and reads it back with Reader. Data is not portable between machines.
+// Overloads for other types must be declared in this namespace.
+namespace binary_io
+{
+
+struct Writer
+{
+    String s;
+
+    void bytes(const void *p, size_t n)
+    {
+        s.append((const char *)p, n);
+    }
+};
+
+struct Reader
+{
+    const char *p;
+    const char *end;
+
+    void bytes(void *dst, size_t n)
+    {
+        if ((size_t)(end - p) < n)
+            throw std::runtime_error("Bad cache data");
+        memcpy(dst, p, n);
+        p += n;
+    }
+};
+
+template <class Ar>
+constexpr bool is_reader = std::is_same_v<Ar, Reader>;
+
+template <class Ar, class T>
+std::enable_if_t<std::is_arithmetic_v<T> || std::is_enum_v<T>> io(Ar &ar, T &v)
+{
+    ar.bytes(&v, sizeof(v));
+}
+
+template <class Ar>
+void io_size(Ar &ar, size_t &n)
+{
+    uint64_t n64 = n;
+    io(ar, n64);
+    n = (size_t)n64;
+}
+
+template <class Ar>
+void io(Ar &ar, String &s)
+{
+    auto n = s.size();
+    io_size(ar, n);
+    if constexpr (is_reader<Ar>)
+        s.resize(n);
+    if (n)
+        ar.bytes(&s[0], n);
+}
+
+template <class Ar>
+void io(Ar &ar, path &p)
+{
+    String s;
+    if constexpr (!is_reader<Ar>)
+        s = p.u8string();
+    io(ar, s);
+    if constexpr (is_reader<Ar>)
+        p = fs::u8path(s);
+}
+
+template <class Ar, size_t N>
+void io(Ar &ar, std::bitset<N> &b)
+{
+    static_assert(N <= 64);
+    uint64_t v = 0;
+    if constexpr (!is_reader<Ar>)
+        v = b.to_ullong();
+    io(ar, v);
+    if constexpr (is_reader<Ar>)
+        b = std::bitset<N>(v);
+}
+
+template <class Ar, class A, class B>
+void io(Ar &ar, std::pair<A, B> &p)
+{
+    io(ar, p.first);
+    io(ar, p.second);
+}
+
+template <class Ar, class T>
+void io(Ar &ar, std::optional<T> &o)
+{
+    bool has = o.has_value();
+    io(ar, has);
+    if constexpr (is_reader<Ar>)
+    {
+        if (has)
+            o.emplace();
+    }
+    if (has)
+        io(ar, *o);
+}
+
+template <class Ar, class T>
+void io(Ar &ar, std::shared_ptr<T> &o)
+{
+    bool has = !!o;
+    io(ar, has);
+    if constexpr (is_reader<Ar>)
+    {
+        if (has)
+            o = std::make_shared<T>();
+    }
+    if (has)
+        io(ar, *o);
+}
+
+template <class Ar, class T>
+void io(Ar &ar, std::vector<T> &v)
+{
+    auto n = v.size();
+    io_size(ar, n);
+    if constexpr (is_reader<Ar>)
+        v.resize(n);
+    for (auto &e : v)
+        io(ar, e);
+}
+
+template <class Ar, class T, size_t N>
+void io(Ar &ar, T (&a)[N])
+{
+    for (auto &e : a)
+        io(ar, e);
+}
+
+// sets and maps
+template <class Ar, class C>
+void io_container(Ar &ar, C &c)
+{
+    auto n = c.size();
+    io_size(ar, n);
+    if constexpr (is_reader<Ar>)
+    {
+        c.clear();
+        // keys of maps are const
+        using V = std::pair<std::remove_const_t<typename C::value_type::first_type>, typename C::value_type::second_type>;
+        for (size_t i = 0; i < n; i++)
+        {
+            V v;
+            io(ar, v);
+            c.insert(c.end(), std::move(v));
+        }
+    }
+    else
+    {
+        for (auto &[k, v] : c)
+        {
+            io(ar, const_cast<std::remove_const_t<std::remove_reference_t<decltype(k)>> &>(k));
+            io(ar, v);
+        }
+    }
+}
+
+template <class Ar, class K, class V, class ... Args>
+void io(Ar &ar, std::map<K, V, Args...> &m)
+{
+    io_container(ar, m);
+}
+
+template <class Ar, class K, class V, class ... Args>
+void io(Ar &ar, std::unordered_map<K, V, Args...> &m)
+{
+    io_container(ar, m);
+}
+
+template <class Ar, class T, class ... Args>
+void io(Ar &ar, std::set<T, Args...> &s)
+{
+    auto n = s.size();
+    io_size(ar, n);
+    if constexpr (is_reader<Ar>)
+    {
+        s.clear();
+        for (size_t i = 0; i < n; i++)
+        {
+            T v;
+            io(ar, v);
+            s.insert(s.end(), std::move(v));
+        }
+    }
+    else
+    {
+        for (auto &e : s)
+            io(ar, const_cast<T &>(e));
+    }
+}
+
+template <class Ar, class ... Types>
+void io(Ar &ar, std::variant<Types...> &v)
+{
+    auto i = v.index();
+    io_size(ar, i);
+    if constexpr (is_reader<Ar>)
+    {
+        if (i >= sizeof...(Types))
+            throw std::runtime_error("Bad cache data");
+        std::variant<Types...> vs[] = { Types()... };
+        v = std::move(vs[i]);
+    }
+    std::visit([&ar](auto &e) { io(ar, e); }, v);
+}
+
+template <class Ar, class ... Args>
+void io_all(Ar &ar, Args &... args)
+{
+    (io(ar, args), ...);
+}
+
+template <class Ar>
+void io(Ar &ar, Version &v)
+{
+    io_all(ar, v.major, v.minor, v.patch, v.branch, v.type);
+}
+
+template <class Ar>
+void io(Ar &ar, ProjectPath &p)
+{
+    ProjectPath::PathElements e;
+    if constexpr (!is_reader<Ar>)
+        e.assign(p.begin(), p.end());
+    io(ar, e);
+    if constexpr (is_reader<Ar>)
+        p = ProjectPath(e);
+}
+
+template <class Ar>
+void io(Ar &ar, Package &p)
+{
+    io_all(ar, p.ppath, p.version, p.flags, p.reference, p.conditions,
+        p.target_name, p.target_name_hash, p.variable_name, p.variable_no_version_name);
+}
+
+}
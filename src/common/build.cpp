@@ -84,7 +84,7 @@ String test_run()
 
     // move this to printer some time
     // copy cached cmake config to storage
-    copy_dir(
+    copy_dir_parallel(
         bin_dir / "CMakeFiles" / cmake_version,
         directories.storage_dir_cfg / hash_config(c) / "CMakeFiles" / cmake_version);
 
@@ -169,7 +169,7 @@ int build_packages(const Config &c, const String &name)
         fs::remove_all(dst);
     if (!fs::exists(dst))
     {
-        copy_dir(src, dst);
+        copy_dir_parallel(src, dst);
         // since cmake 3.8
         write_file(bs.binary_directory / "CMakeCache.txt", "CMAKE_PLATFORM_INFO_INITIALIZED:INTERNAL=1\n");
     }
@@ -507,7 +507,8 @@ bool Checks::empty() const
 
 Checks &Checks::operator+=(const Checks &rhs)
 {
-    checks.insert(rhs.checks.begin(), rhs.checks.end());
+    for (auto &c : rhs.checks)
+        checks.insert(c);
     return *this;
 }
 
@@ -843,12 +844,14 @@ void Checks::write_definitions(CMakeEmitter &ctx, const Package &d, const String
 
 void Checks::remove_known_vars(const std::set<String> &known_vars)
 {
-    auto checks_old = checks;
-    for (auto &c : checks_old)
+    std::vector<CheckPtr> known;
+    for (auto &c : checks)
     {
         if (known_vars.find(c->getVariable()) != known_vars.end())
-            checks.erase(c);
+            known.push_back(c);
     }
+    for (auto &c : known)
+        checks.erase(c);
 }
 
 std::vector<Checks> Checks::scatter(int N) const
@@ -977,6 +980,58 @@ String Check::make_struct_member_var(const String &m, const String &s)
     return make_include_var(s + " " + m);
 }
 
+void Check::createId()
+{
+    size_t h = 0;
+    hash_combine(h, information.type);
+    hash_combine(h, variable);
+    hash_combine(h, parameters);
+    id = h;
+}
+
+bool Check::isSame(const Check &c) const
+{
+    return
+        std::tie(information.type, variable, parameters) ==
+        std::tie(c.information.type, c.variable, c.parameters);
+}
+
+std::pair<ChecksSet::iterator, bool> ChecksSet::insert(const CheckPtr &c)
+{
+    if (!c->id)
+        c->createId();
+    auto r = index.equal_range(c->id);
+    for (auto i = r.first; i != r.second; ++i)
+    {
+        // ids may collide
+        if (i->second->isSame(*c))
+            return { checks.find(i->second), false };
+    }
+    auto ri = checks.insert(c);
+    index.emplace(c->id, c);
+    return ri;
+}
+
+void ChecksSet::erase(const CheckPtr &c)
+{
+    auto r = index.equal_range(c->id);
+    for (auto i = r.first; i != r.second; ++i)
+    {
+        if (i->second->isSame(*c))
+        {
+            checks.erase(i->second);
+            index.erase(i);
+            return;
+        }
+    }
+}
+
+void ChecksSet::clear()
+{
+    checks.clear();
+    index.clear();
+}
+
 String Check::getFileName() const
 {
     if (parameters.empty())
@@ -1098,6 +1153,13 @@ bool CheckParameters::empty() const
 bool CheckParameters::operator<(const CheckParameters &p) const
 {
     return
-        std::tie(headers, definitions, include_directories, libraries, flags) <
-        std::tie(p.headers, p.definitions, p.include_directories, p.libraries, p.flags);
+        std::tie(headers, definitions, include_directories, libraries, flags, all_includes) <
+        std::tie(p.headers, p.definitions, p.include_directories, p.libraries, p.flags, p.all_includes);
+}
+
+bool CheckParameters::operator==(const CheckParameters &p) const
+{
+    return
+        std::tie(headers, definitions, include_directories, libraries, flags, all_includes) ==
+        std::tie(p.headers, p.definitions, p.include_directories, p.libraries, p.flags, p.all_includes);
 }
@@ -21,6 +21,10 @@
 #include "filesystem.h"
 #include "yaml.h"
 
+#include <primitives/hash_combine.h>
+
+#include <unordered_map>
+
 class CMakeEmitter;
 struct Package;
 
@@ -45,6 +49,7 @@ struct CheckParameters
     bool empty() const;
     String getHash() const;
     bool operator<(const CheckParameters &p) const;
+    bool operator==(const CheckParameters &p) const;
 };
 
 class Check
@@ -102,6 +107,10 @@ public:
 
     void setValue(const Value &v) { value = v; }
 
+    // hash of identity (type, variable and parameters), set when check is added to ChecksSet
+    uint64_t getId() const { return id; }
+    bool isSame(const Check &c) const;
+
     bool get_cpp() const { return cpp; }
     virtual void set_cpp(bool) {}
 
@@ -153,26 +162,61 @@ public:
     static String make_struct_member_var(const String &m, const String &s);
 
 private:
+    uint64_t id = 0;
+
+    void createId();
+
     template <class T>
     friend struct CheckPtrLess;
+    friend class ChecksSet;
 };
 
 using CheckPtr = std::shared_ptr<Check>;
 
+// parameters are compared by id first, and only when ids are equal
 template <class T>
 struct CheckPtrLess
 {
     bool operator()(const T &p1, const T &p2) const
     {
         if (p1 && p2)
-            return
-            std::tie(p1->information.type, p1->variable, p1->parameters) <
-            std::tie(p2->information.type, p2->variable, p2->parameters);
+        {
+            auto t1 = std::tie(p1->information.type, p1->variable, p1->id);
+            auto t2 = std::tie(p2->information.type, p2->variable, p2->id);
+            if (t1 != t2)
+                return t1 < t2;
+            return p1->parameters < p2->parameters;
+        }
         return p1 < p2;
     }
 };
 
-using ChecksSet = std::set<CheckPtr, CheckPtrLess<CheckPtr>>;
+// Checks ordered by type and variable (decls go last).
+// Duplicates are looked up by id in the hash index and then compared, so merging is linear.
+// The index keeps pointers, not set iterators, so copies of the set stay valid.
+class ChecksSet
+{
+    using Set = std::set<CheckPtr, CheckPtrLess<CheckPtr>>;
+
+public:
+    using iterator = Set::const_iterator;
+    using const_iterator = Set::const_iterator;
+
+    // returns already present check with the same id, if any
+    std::pair<iterator, bool> insert(const CheckPtr &c);
+    void erase(const CheckPtr &c);
+    void clear();
+
+    iterator begin() const { return checks.begin(); }
+    iterator end() const { return checks.end(); }
+
+    bool empty() const { return checks.empty(); }
+    size_t size() const { return checks.size(); }
+
+private:
+    Set checks;
+    std::unordered_multimap<uint64_t, CheckPtr> index;
+};
 
 struct Checks
 {
@@ -216,3 +260,29 @@ struct ParallelCheckOptions
     String toolset;
     String toolchain;
 };
+
+namespace std
+{
+
+template<> struct hash<CheckParameters>
+{
+    size_t operator()(const CheckParameters& p) const
+    {
+        size_t h = 0;
+        // sizes separate the lists
+        auto add = [&h](const auto &c)
+        {
+            hash_combine(h, c.size());
+            for (auto &v : c)
+                hash_combine(h, v);
+        };
+        add(p.headers);
+        add(p.definitions);
+        add(p.include_directories);
+        add(p.libraries);
+        add(p.flags);
+        return hash_combine(h, p.all_includes);
+    }
+};
+
+}
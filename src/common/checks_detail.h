@@ -515,6 +515,6 @@ template <class T, class ... Args>
 T *Checks::addCheck(Args && ... args)
 {
     auto i = std::make_shared<T>(std::forward<Args>(args)...);
-    auto r = checks.emplace(std::move(i));
+    auto r = checks.insert(i);
     return (T*)r.first->get();
 }
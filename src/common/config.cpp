@@ -48,6 +48,19 @@ Config::Config(const path &p, bool local)
     reload(p);
 }
 
+Config::Config(const Config &c, const Projects::value_type &p)
+    : projects{ p }
+    , dir(c.dir)
+    , subdir(c.subdir)
+    , defaults_allowed(c.defaults_allowed)
+    , allow_relative_project_names(c.allow_relative_project_names)
+    , allow_local_dependencies(c.allow_local_dependencies)
+    , is_local(c.is_local)
+    , created(c.created)
+    , pkg(c.pkg)
+{
+}
+
 void Config::reload(const path &p)
 {
     if (fs::is_directory(p))
@@ -153,7 +166,7 @@ void Config::load(const yaml &root)
                 reload(d);
 
                 for (auto &[s, p] : projects)
-                    rd.known_local_packages.insert(p.pkg);
+                    rd.known_local_packages.insert(getPackageId(p.pkg));
 
                 subdir_projects.insert(projects.begin(), projects.end());
                 projects.clear();
@@ -182,7 +195,7 @@ void Config::load(const yaml &root)
                     reload(d);
 
                     for (auto &[s, p] : projects)
-                        rd.known_local_packages.insert(p.pkg);
+                        rd.known_local_packages.insert(getPackageId(p.pkg));
 
                     all_projects.insert(projects.begin(), projects.end());
                     projects.clear();
@@ -378,13 +391,10 @@ void Config::setPackage(const Package &p)
 
 std::vector<Config> Config::split() const
 {
+    // every project is copied once, other projects are not touched
     std::vector<Config> configs;
+    configs.reserve(projects.size());
     for (auto &p : projects)
-    {
-        Config c = *this;
-        c.projects.clear();
-        c.projects.insert(p);
-        configs.push_back(c);
-    }
+        configs.push_back(Config(*this, p));
     return configs;
 }
@@ -60,10 +60,16 @@ struct Config
     Packages getFileDependencies() const; // from file
 
 private:
+    // new fields must be added to ConfigCache and to the split constructor too
+    friend struct ConfigCache;
+
     Projects projects;
     path dir; // cwd
     String subdir; // for add_directories
 
+    // settings of c with the single project p
+    Config(const Config &c, const Projects::value_type &p);
+
     void addDefaultProject();
     Project &getProject1(const ProjectPath &ppath);
 
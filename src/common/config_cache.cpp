@@ -0,0 +1,239 @@
+/*
+ * Copyright (C) 2016-2017, Egor Pugin
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "config_cache.h"
+
+#include "binary_io.h"
+#include "config.h"
+#include "directories.h"
+#include "hash.h"
+#include "program.h"
+
+#include <algorithm>
+
+#include <primitives/log.h>
+//DECLARE_STATIC_LOGGER(logger, "config_cache");
+
+// bump when serialized data or loading of configs are changed
+#define CONFIG_CACHE_VERSION 1
+
+namespace binary_io
+{
+
+template <class Ar>
+void io(Ar &ar, Git &s)
+{
+    io_all(ar, s.url, s.tag, s.branch, s.commit);
+}
+
+template <class Ar>
+void io(Ar &ar, Hg &s)
+{
+    io_all(ar, (Git &)s, s.revision);
+}
+
+template <class Ar>
+void io(Ar &ar, Bzr &s)
+{
+    io_all(ar, s.url, s.tag, s.revision);
+}
+
+template <class Ar>
+void io(Ar &ar, Fossil &s)
+{
+    io(ar, (Git &)s);
+}
+
+template <class Ar>
+void io(Ar &ar, Cvs &s)
+{
+    io_all(ar, s.url, s.tag, s.branch, s.revision, s.module);
+}
+
+template <class Ar>
+void io(Ar &ar, Svn &s)
+{
+    io_all(ar, s.url, s.tag, s.branch, s.revision);
+}
+
+template <class Ar>
+void io(Ar &ar, RemoteFile &s)
+{
+    io(ar, s.url);
+}
+
+template <class Ar>
+void io(Ar &ar, RemoteFiles &s)
+{
+    io(ar, s.urls);
+}
+
+template <class Ar>
+void io(Ar &ar, IncludeDirectories &d)
+{
+    io_all(ar, d.public_, d.private_, d.interface_);
+}
+
+template <class Ar>
+void io(Ar &ar, BuildSystemConfigInsertions &b)
+{
+#define BSI(x) io(ar, b.x);
+#include "bsi.inl"
+#undef BSI
+}
+
+template <class Ar>
+void io(Ar &ar, Options &o)
+{
+    io_all(ar, o.definitions, o.include_directories, o.compile_options, o.link_options, o.link_libraries, o.link_directories,
+        o.system_definitions, o.system_include_directories, o.system_compile_options, o.system_link_options,
+        o.system_link_libraries, o.system_link_directories, o.bs_insertions);
+}
+
+template <class Ar>
+void io(Ar &ar, Patch &p)
+{
+    io_all(ar, p.replace, p.regex_replace, p.file_patches);
+}
+
+// checks are polymorphic, user checks are stored in their yaml form,
+// default checks are added on load
+template <class Ar>
+void io(Ar &ar, Checks &c)
+{
+    String s;
+    if constexpr (!is_reader<Ar>)
+    {
+        if (std::any_of(c.checks.begin(), c.checks.end(), [](auto &ch) { return !ch->default_; }))
+            s = c.save();
+    }
+    io_all(ar, s, c.valid);
+    if constexpr (is_reader<Ar>)
+    {
+        auto valid = c.valid;
+        c.checks.clear();
+        c.load(s.empty() ? yaml() : load_yaml_config(s));
+        c.valid = valid;
+    }
+}
+
+}
+
+// has access to private data
+struct ConfigCache
+{
+    template <class Ar>
+    static void io(Ar &ar, Project &p)
+    {
+        io_all(ar, p.source, p.pkg, p.license, p.include_directories,
+            p.sources, p.build_files, p.exclude_from_package, p.exclude_from_build, p.public_headers, p.include_hints,
+            p.dependencies, p.bs_insertions, p.include_script, p.options, p.patch, p.aliases, p.checks, p.checks_prefixes,
+            p.empty, p.custom, p.shared_only, p.static_only,
+            p.c_standard, p.c_extensions, p.cxx_standard, p.cxx_extensions,
+            p.import_from_bazel, p.bazel_target_function, p.bazel_target_name,
+            p.prefer_binaries, p.export_all_symbols, p.export_if_static, p.build_dependencies_with_same_config,
+            p.rc_enabled, p.skip_on_server, p.create_default_api, p.default_api_start, p.copy_to_output_dir,
+            p.api_name, p.output_name, p.condition, p.files, p.root_directory, p.unpack_directory, p.output_directory,
+            p.name, p.type, p.library_type, p.executable_type,
+            p.defaults_allowed, p.allow_local_dependencies, p.allow_relative_project_names, p.is_local, p.subdir,
+            p.header_only, p.files_loaded, p.original_project, p.root_project);
+    }
+
+    template <class Ar>
+    static void io(Ar &ar, Config &c)
+    {
+        io_all(ar, c.projects, c.dir, c.subdir,
+            c.defaults_allowed, c.allow_relative_project_names, c.allow_local_dependencies, c.is_local,
+            c.created, c.pkg);
+    }
+};
+
+namespace binary_io
+{
+
+template <class Ar>
+void io(Ar &ar, Project &p)
+{
+    ConfigCache::io(ar, p);
+}
+
+template <class Ar>
+void io(Ar &ar, Config &c)
+{
+    ConfigCache::io(ar, c);
+}
+
+}
+
+String serialize_config(const Config &c)
+{
+    binary_io::Writer w;
+    binary_io::io(w, const_cast<Config &>(c));
+    return w.s;
+}
+
+void deserialize_config(Config &c, const String &s)
+{
+    binary_io::Reader r{ s.data(), s.data() + s.size() };
+    binary_io::io(r, c);
+    if (r.p != r.end)
+        throw std::runtime_error("Bad config cache");
+}
+
+std::unique_ptr<Config> load_config_cached(const path &dir)
+{
+    auto fn = dir / CPPAN_FILENAME;
+    if (!fs::exists(fn))
+        return std::make_unique<Config>(dir, false);
+
+    auto s = read_file(fn);
+
+    // loading of such configs has side effects
+    bool cacheable = s.find("local_settings") == s.npos && s.find("add_directories") == s.npos;
+    if (!cacheable)
+        return std::make_unique<Config>(dir, false);
+
+    auto key = std::to_string(CONFIG_CACHE_VERSION) + "\n" + get_program_version() + "\n" +
+        normalize_path(dir) + "\n" + s;
+    // full hash, file does not store the key
+    auto cache_fn = directories.storage_dir_tmp / "configs" / sha256(key);
+
+    if (fs::exists(cache_fn))
+    {
+        try
+        {
+            auto c = std::make_unique<Config>();
+            deserialize_config(*c, read_file(cache_fn));
+            return c;
+        }
+        catch (std::exception &e)
+        {
+            LOG_DEBUG(logger, "Cannot read cached config " << cache_fn.string() << ": " << e.what());
+        }
+    }
+
+    auto c = std::make_unique<Config>(dir, false);
+
+    // other processes may read it at the same time
+    fs::create_directories(cache_fn.parent_path());
+    auto tmp = path(cache_fn) += "." + unique_path().string();
+    write_file(tmp, serialize_config(*c));
+    error_code ec;
+    fs::rename(tmp, cache_fn, ec);
+    if (ec)
+        fs::remove(tmp, ec);
+    return c;
+}
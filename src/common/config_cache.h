@@ -0,0 +1,32 @@
+/*
+ * Copyright (C) 2016-2017, Egor Pugin
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "filesystem.h"
+
+#include <memory>
+
+struct Config;
+
+// Loads config of the downloaded package from its storage dir (as Config(dir, false)).
+// Such packages never change, so loaded configs are cached in binary form.
+// Cache key: config contents, its dir, client version.
+std::unique_ptr<Config> load_config_cached(const path &dir);
+
+// for tests
+String serialize_config(const Config &c);
+void deserialize_config(Config &c, const String &s);
@@ -36,6 +36,7 @@
 #include <boost/date_time/posix_time/posix_time.hpp>
 #include <sqlite3.h>
 
+#include <mutex>
 #include <shared_mutex>
 
 #include <primitives/log.h>
@@ -249,6 +250,14 @@ path getDbDirectory()
     return directories.storage_dir_etc / db_dir_name;
 }
 
+// with wal journal, stale -wal/-shm files would be replayed into a new db
+void removeDatabaseFiles(const path &fn)
+{
+    fs::remove(fn);
+    fs::remove(path(fn) += "-wal");
+    fs::remove(path(fn) += "-shm");
+}
+
 int readPackagesDbSchemaVersion(const path &dir)
 {
     auto p = dir / PACKAGES_DB_SCHEMA_VERSION_FILE;
@@ -279,6 +288,7 @@ ServiceDatabase &getServiceDatabase(bool init)
 {
     // this holder will init on-disk sdb once
     // later thread local calls will just open it
+    // (one connection per thread, they are opened with SQLITE_OPEN_NOMUTEX)
     static ServiceDatabase run_once_db;
     if (init)
         run_once_db.init();
@@ -315,6 +325,29 @@ PackagesDatabase &getPackagesDatabase()
     return db;
 }
 
+std::optional<int> ServiceDatabase::InstalledPackageIds::get(const Package &p) const
+{
+    std::shared_lock<std::shared_mutex> lk(m);
+    auto i = ids.find(p);
+    if (i == ids.end())
+        return {};
+    return i->second;
+}
+
+void ServiceDatabase::InstalledPackageIds::set(const Package &p, int id)
+{
+    std::unique_lock<std::shared_mutex> lk(m);
+    ids[p] = id;
+}
+
+void ServiceDatabase::InstalledPackageIds::erase(const Package &p)
+{
+    std::unique_lock<std::shared_mutex> lk(m);
+    ids.erase(p);
+}
+
+ServiceDatabase::InstalledPackageIds ServiceDatabase::installed_package_ids;
+
 Database::Database(const String &name, const TableDescriptors &tds)
     : tds(tds)
 {
@@ -337,19 +370,15 @@ Database::Database(const String &name, const TableDescriptors &tds)
 
 void Database::open(bool read_only)
 {
+    // busy handling (retries with backoff) is set up by SqliteDatabase
     db = std::make_unique<SqliteDatabase>(fn.string(), read_only);
-
-    // prevent SQLITE_BUSY rc
-    // hope 1 min is enough to wait for write operation
-    // in multithreaded environment
-    sqlite3_busy_timeout(db->getDb(), 60000);
 }
 
 void Database::recreate()
 {
     db.reset();
     ScopedFileLock lock(fn);
-    fs::remove(fn);
+    removeDatabaseFiles(fn);
     open();
     for (auto &td : tds)
         db->execute(td.query);
@@ -363,16 +392,82 @@ ServiceDatabase::ServiceDatabase()
 
 void ServiceDatabase::init()
 {
-    RUN_ONCE
+    // connections are opened without sqlite mutexes, so only one thread
+    // may use this (shared) connection at a time
+    static std::recursive_mutex m;
+    std::unique_lock<std::recursive_mutex> lk(m);
+
+    // startup actions may try to init sdb again (same thread)
+    static bool initialized = false;
+    if (initialized)
+        return;
+    initialized = true;
+
+    auto t0 = Clock::now();
+    try
     {
-        createTables();
-        checkStamp();
+        // on usual runs this is the only check we do
+        if (getStamp() != getSchemaStamp())
+            migrate();
+        else if (!isCmakePackageRegistered())
+            // user may remove it, restore
+            registerCmakePackage();
         increaseNumberOfRuns();
         checkForUpdates();
-    };
+    }
+    catch (...)
+    {
+        initialized = false;
+        throw;
+    }
+    LOG_TRACE(logger, "Service database init took " <<
+        std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - t0).count() << " ms");
+}
+
+String ServiceDatabase::getSchemaStamp() const
+{
+    // client version + tables + startup actions
+    // if any of them is changed, we run full migration
+    String s;
+    for (auto &td : tds)
+        s += td.name + td.query;
+    for (auto &a : startup_actions)
+        s += std::to_string(a.id) + "." + std::to_string(a.action) + ";";
+    return cppan_stamp + "-" + sha256_short(s);
+}
+
+String ServiceDatabase::getStamp() const
+{
+    String s;
+    // table is missing on fresh db, so do not throw
+    db->execute("select stamp from ClientStamp",
+        [&s](SQLITE_CALLBACK_ARGS)
+    {
+        s = cols[0];
+        return 0;
+    }, true);
+    return s;
+}
+
+void ServiceDatabase::setStamp(const String &stamp) const
+{
+    db->execute("delete from ClientStamp");
+    db->execute("insert into ClientStamp values ('" + stamp + "')");
+}
+
+void ServiceDatabase::migrate() const
+{
+    LOG_TRACE(logger, "Service database stamp is changed, updating storage");
+
+    createTables();
 
-    // move out of RUN_ONCE because it may try to init sdb again
+    // if stamp is changed, we do some usual stuff between versions
+    clearFileStamps();
+    registerCmakePackage();
     performStartupActions();
+
+    // write stamp last, so interrupted migration will be repeated
+    setStamp(getSchemaStamp());
 }
 
 void ServiceDatabase::createTables() const
@@ -414,33 +509,8 @@ void ServiceDatabase::recreateTable(const TableDescriptor &td) const
     setTableHash(td.name, sha256(td.query));
 }
 
-void ServiceDatabase::checkStamp() const
-{
-    String s;
-    db->execute("select * from ClientStamp",
-        [&s](SQLITE_CALLBACK_ARGS)
-    {
-        s = cols[0];
-        return 0;
-    });
-
-    if (s == cppan_stamp)
-        return;
-
-    if (s.empty())
-        db->execute("replace into ClientStamp values ('" + cppan_stamp + "')");
-    else
-        db->execute("update ClientStamp set stamp = '" + cppan_stamp + "'");
-
-    // if stamp is changed, we do some usual stuff between versions
-
-    clearFileStamps();
-}
-
 void ServiceDatabase::performStartupActions() const
 {
-    registerCmakePackage();
-
     // perform startup actions on client update
     try
     {
@@ -501,7 +571,7 @@ void ServiceDatabase::performStartupActions() const
 
             if (a.action & StartupAction::ClearPackagesDatabase)
             {
-                fs::remove(getDbDirectory() / packages_db_name);
+                removeDatabaseFiles(getDbDirectory() / packages_db_name);
             }
 
             if (a.action & StartupAction::ClearStorageDirExp)
@@ -767,20 +837,59 @@ void ServiceDatabase::setSourceGroups(const Package &p, const SourceGroups &sgs)
     auto id = getInstalledPackageId(p);
     if (id == 0)
         return;
-    removeSourceGroups(id);
-    for (auto &sg : sgs)
+
+    auto mdb = db->getDb();
+    auto prepare = [mdb](const String &query)
+    {
+        sqlite3_stmt *stmt = nullptr;
+        if (sqlite3_prepare_v2(mdb, query.c_str(), (int)query.size() + 1, &stmt, 0) != SQLITE_OK)
+            throw std::runtime_error(sqlite3_errmsg(mdb));
+        return stmt;
+    };
+    auto step = [mdb](sqlite3_stmt *stmt)
+    {
+        if (sqlite3_step(stmt) != SQLITE_DONE)
+            throw std::runtime_error(String("sqlite3_step() failed: ") + sqlite3_errmsg(mdb));
+        if (sqlite3_reset(stmt) != SQLITE_OK)
+            throw std::runtime_error("sqlite3_reset() failed");
+    };
+
+    sqlite3_stmt *stmt_sg = nullptr;
+    sqlite3_stmt *stmt_files = nullptr;
+    SCOPE_EXIT
     {
-        db->execute("insert into SourceGroups (package_id, path) values ('" + std::to_string(id) + "', '" + sg.first + "');");
-        if (!sg.second.empty())
+        sqlite3_finalize(stmt_sg);
+        sqlite3_finalize(stmt_files);
+    };
+
+    // one transaction for the whole package
+    db->execute("BEGIN;");
+    try
+    {
+        removeSourceGroups(id);
+
+        stmt_sg = prepare("insert into SourceGroups (package_id, path) values (?, ?);");
+        stmt_files = prepare("insert into SourceGroupFiles values (?, ?);");
+        for (auto &sg : sgs)
         {
+            sqlite3_bind_int64(stmt_sg, 1, id);
+            sqlite3_bind_text(stmt_sg, 2, sg.first.c_str(), -1, SQLITE_STATIC);
+            step(stmt_sg);
+
             auto sg_id = db->getLastRowId();
-            String q = "insert into SourceGroupFiles values ";
             for (auto &f : sg.second)
-                q += "('" + std::to_string(sg_id) + "', '" + f + "'),";
-            q.resize(q.size() - 1);
-            q += ";";
-            db->execute(q);
+            {
+                sqlite3_bind_int64(stmt_files, 1, sg_id);
+                sqlite3_bind_text(stmt_files, 2, f.c_str(), -1, SQLITE_STATIC);
+                step(stmt_files);
+            }
         }
+        db->execute("COMMIT;");
+    }
+    catch (...)
+    {
+        db->execute("ROLLBACK;", nullptr, true);
+        throw;
     }
 }
 
@@ -790,23 +899,18 @@ SourceGroups ServiceDatabase::getSourceGroups(const Package &p) const
     auto id = getInstalledPackageId(p);
     if (id == 0)
         return sgs;
-    std::map<int, String> ids;
-    db->execute("select id, path from SourceGroups where package_id = '" + std::to_string(id) + "';",
-        [&ids](SQLITE_CALLBACK_ARGS)
+    // single query instead of one per group
+    db->execute(
+        "select SourceGroups.path, SourceGroupFiles.path from SourceGroups "
+        "left join SourceGroupFiles on source_group_id = SourceGroups.id "
+        "where package_id = '" + std::to_string(id) + "';",
+        [&sgs](SQLITE_CALLBACK_ARGS)
     {
-        ids[std::stoi(cols[0])] = cols[1];
+        auto &sg = sgs[cols[0]];
+        if (cols[1])
+            sg.insert(cols[1]);
         return 0;
     });
-    for (auto &i : ids)
-    {
-        auto &sg = sgs[i.second];
-        db->execute("select path from SourceGroupFiles where source_group_id = '" + std::to_string(i.first) + "';",
-            [&sg](SQLITE_CALLBACK_ARGS)
-        {
-            sg.insert(cols[0]);
-            return 0;
-        });
-    }
     return sgs;
 }
 
@@ -820,6 +924,9 @@ void ServiceDatabase::removeSourceGroups(const Package &p) const
 
 void ServiceDatabase::removeSourceGroups(int id) const
 {
+    // foreign keys are off, so do not rely on cascade delete
+    db->execute("delete from SourceGroupFiles where source_group_id in "
+        "(select id from SourceGroups where package_id = '" + std::to_string(id) + "');");
     db->execute("delete from SourceGroups where package_id = '" + std::to_string(id) + "';");
 }
 
@@ -835,11 +942,13 @@ void ServiceDatabase::addInstalledPackage(const Package &p) const
     if (getInstalledPackageHash(p) == h)
         return;
     db->execute("replace into InstalledPackages (package, version, hash) values ('" + p.ppath.toString() + "', '" + p.version.toString() + "', '" + p.getFilesystemHash() + "')");
+    installed_package_ids.erase(p);
 }
 
 void ServiceDatabase::removeInstalledPackage(const Package &p) const
 {
     db->execute("delete from InstalledPackages where package = '" + p.ppath.toString() + "' and version = '" + p.version.toString() + "'");
+    installed_package_ids.erase(p);
 }
 
 String ServiceDatabase::getInstalledPackageHash(const Package &p) const
@@ -856,6 +965,9 @@ String ServiceDatabase::getInstalledPackageHash(const Package &p) const
 
 int ServiceDatabase::getInstalledPackageId(const Package &p) const
 {
+    if (auto id = installed_package_ids.get(p))
+        return id.value();
+
     int id = 0;
     db->execute("select id from InstalledPackages where package = '" + p.ppath.toString() + "' and version = '" + p.version.toString() + "'",
         [&id](SQLITE_CALLBACK_ARGS)
@@ -863,6 +975,9 @@ int ServiceDatabase::getInstalledPackageId(const Package &p) const
         id = std::stoi(cols[0]);
         return 0;
     });
+    // misses are not cached, package may be installed later (also by other process)
+    if (id)
+        installed_package_ids.set(p, id);
     return id;
 }
 
@@ -1099,98 +1214,109 @@ bool PackagesDatabase::isCurrentDbOld() const
     return (tp - tp_old) > std::chrono::minutes(PACKAGES_DB_REFRESH_TIME_MINUTES);
 }
 
-IdDependencies PackagesDatabase::findDependencies(const Packages &deps) const
+void PackagesDatabase::findDependencies(const Package &dep, DependencyGraph &g) const
 {
-    DependenciesMap all_deps;
-    for (auto &dep : deps)
+    ProjectType type;
+    DownloadDependency project;
+    project.ppath = dep.ppath;
+    project.version = dep.version;
+
+    db->execute("select id, type_id, flags from Projects where path = '" + dep.ppath.toString() + "'",
+        [&project, &type](SQLITE_CALLBACK_ARGS)
     {
-        if (dep.second.flags[pfLocalProject])
-            continue;
+        project.id = std::stoull(cols[0]);
+        type = (ProjectType)std::stoi(cols[1]);
+        project.flags = std::stoull(cols[2]);
+        return 0;
+    });
+
+    if (project.id == 0)
+        // TODO: replace later with typed exception, so client will try to fetch same package from server
+        throw std::runtime_error("Package '" + project.ppath.toString() + "' not found.");
 
-        ProjectType type;
-        DownloadDependency project;
-        project.ppath = dep.second.ppath;
-        project.version = dep.second.version;
+    auto find_deps = [&g, this](auto &dependency)
+    {
+        dependency.flags.set(pfDirectDependency);
+        dependency.id = getExactProjectVersionId(dependency, dependency.version, dependency.flags, dependency.hash);
+        auto n = g.add(dependency); // add first, deps assign second
+        std::vector<Version> requested;
+        auto deps = getProjectDependencies(dependency.id, g, &requested);
+        g[n].dependencies = std::move(deps);
+        g[n].requested_versions = std::move(requested);
+    };
+
+    if (type == ProjectType::RootProject)
+    {
+        std::vector<DownloadDependency> projects;
 
-        db->execute("select id, type_id, flags from Projects where path = '" + dep.second.ppath.toString() + "'",
-            [&project, &type](SQLITE_CALLBACK_ARGS)
+        // root projects should return all children (lib, exe)
+        db->execute("select id, path, flags from Projects where path like '" + project.ppath.toString() +
+            ".%' and type_id in ('1','2') order by path",
+            [&projects, &project](SQLITE_CALLBACK_ARGS)
         {
-            project.id = std::stoull(cols[0]);
-            type = (ProjectType)std::stoi(cols[1]);
-            project.flags = std::stoull(cols[2]);
+            DownloadDependency dep;
+            dep.id = std::stoull(cols[0]);
+            dep.ppath = String(cols[1]);
+            dep.version = project.version;
+            dep.flags = std::stoull(cols[2]);
+            projects.push_back(dep);
             return 0;
         });
 
-        if (project.id == 0)
+        if (projects.empty())
             // TODO: replace later with typed exception, so client will try to fetch same package from server
-            throw std::runtime_error("Package '" + project.ppath.toString() + "' not found.");
+            throw std::runtime_error("Root project '" + project.ppath.toString() + "' is empty");
 
-        auto find_deps = [&all_deps, this](auto &dependency)
+        int n = 0;
+        for (auto &p : projects)
         {
-            dependency.flags.set(pfDirectDependency);
-            dependency.id = getExactProjectVersionId(dependency, dependency.version, dependency.flags, dependency.hash);
-            all_deps[dependency] = dependency; // assign first, deps assign second
-            all_deps[dependency].db_dependencies = getProjectDependencies(dependency.id, all_deps);
-        };
-
-        if (type == ProjectType::RootProject)
-        {
-            std::vector<DownloadDependency> projects;
-
-            // root projects should return all children (lib, exe)
-            db->execute("select id, path, flags from Projects where path like '" + project.ppath.toString() +
-                ".%' and type_id in ('1','2') order by path",
-                [&projects, &project](SQLITE_CALLBACK_ARGS)
+            try
             {
-                DownloadDependency dep;
-                dep.id = std::stoull(cols[0]);
-                dep.ppath = String(cols[1]);
-                dep.version = project.version;
-                dep.flags = std::stoull(cols[2]);
-                projects.push_back(dep);
-                return 0;
-            });
-
-            if (projects.empty())
-                // TODO: replace later with typed exception, so client will try to fetch same package from server
-                throw std::runtime_error("Root project '" + project.ppath.toString() + "' is empty");
-
-            int n = 0;
-            for (auto &p : projects)
-            {
-                try
-                {
-                    find_deps(p);
-                    n++;
-                }
-                catch (NoSuchVersion &)
-                {
-                }
+                find_deps(p);
+                n++;
             }
-            if (n == 0)
+            catch (NoSuchVersion &)
             {
-                throw NoSuchVersion("No such version/branch '" + project.version.toAnyVersion() + "' for project '" +
-                    project.ppath.toString() + "'");
             }
         }
-        else
+        if (n == 0)
         {
-            find_deps(project);
+            throw NoSuchVersion("No such version/branch '" + project.version.toAnyVersion() + "' for project '" +
+                project.ppath.toString() + "'");
         }
     }
+    else
+    {
+        find_deps(project);
+    }
+}
 
-    // make id deps
-    IdDependencies dds;
-    for (auto &ad : all_deps)
+DependencyGraph PackagesDatabase::findDependencies(const Packages &deps, Packages *failed) const
+{
+    DependencyGraph g;
+    for (auto &dep : deps)
     {
-        auto &d = ad.second;
-        std::unordered_set<ProjectVersionId> ids;
-        for (auto &dd2 : d.db_dependencies)
-            ids.insert(dd2.second.id);
-        d.setDependencyIds(ids);
-        dds[d.id] = d;
+        if (dep.second.flags[pfLocalProject])
+            continue;
+
+        // a failed package must not leave its partial subgraph
+        g.checkpoint();
+        try
+        {
+            findDependencies(dep.second, g);
+        }
+        catch (std::exception &e)
+        {
+            if (!failed)
+                throw;
+            LOG_DEBUG(logger, "Cannot resolve '" + dep.second.ppath.toString() + "' from local database: " << e.what());
+            failed->insert(dep);
+            g.rollback();
+            continue;
+        }
     }
-    return dds;
+    g.commit();
+    return g;
 }
 
 void check_version_age(const TimePoint &t1, const char *created)
@@ -1331,9 +1457,10 @@ ProjectVersionId PackagesDatabase::getExactProjectVersionId(const DownloadDepend
     return id;
 }
 
-PackagesDatabase::Dependencies PackagesDatabase::getProjectDependencies(ProjectVersionId project_version_id, DependenciesMap &dm) const
+std::vector<DependencyGraph::NodeId> PackagesDatabase::getProjectDependencies(ProjectVersionId project_version_id, DependencyGraph &g,
+    std::vector<Version> *requested) const
 {
-    Dependencies dependencies;
+    std::vector<DependencyGraph::NodeId> dependencies;
     std::vector<DownloadDependency> deps;
 
     db->execute(
@@ -1355,14 +1482,19 @@ PackagesDatabase::Dependencies PackagesDatabase::getProjectDependencies(ProjectV
 
     for (auto &dependency : deps)
     {
+        if (requested)
+            requested->push_back(dependency.version);
         dependency.id = getExactProjectVersionId(dependency, dependency.version, dependency.flags, dependency.hash);
-        auto i = dm.find(dependency);
-        if (i == dm.end())
+        auto n = g.find(dependency);
+        if (!n)
         {
-            dm[dependency] = dependency; // assign first, deps assign second
-            dm[dependency].db_dependencies = getProjectDependencies(dependency.id, dm);
+            n = g.add(dependency); // add first, deps assign second
+            std::vector<Version> requested2;
+            auto deps2 = getProjectDependencies(dependency.id, g, &requested2);
+            g[*n].dependencies = std::move(deps2);
+            g[*n].requested_versions = std::move(requested2);
         }
-        dependencies[dependency.ppath.toString()] = dependency;
+        dependencies.push_back(*n);
     }
     return dependencies;
 }
@@ -24,6 +24,8 @@
 
 #include <chrono>
 #include <memory>
+#include <optional>
+#include <shared_mutex>
 #include <vector>
 
 class SqliteDatabase;
@@ -126,8 +128,25 @@ public:
     void clearFileStamps() const;
 
 private:
+    // installed package ids for the whole run (shared by all thread local connections)
+    struct InstalledPackageIds
+    {
+        std::optional<int> get(const Package &p) const;
+        void set(const Package &p, int id);
+        void erase(const Package &p);
+
+    private:
+        mutable std::shared_mutex m;
+        std::unordered_map<Package, int> ids;
+    };
+    static InstalledPackageIds installed_package_ids;
+
     void createTables() const;
-    void checkStamp() const;
+    void migrate() const;
+
+    String getSchemaStamp() const;
+    String getStamp() const;
+    void setStamp(const String &stamp) const;
 
     String getTableHash(const String &table) const;
     void setTableHash(const String &table, const String &hash) const;
@@ -137,13 +156,12 @@ private:
 
 class PackagesDatabase : public Database
 {
-    using Dependencies = DownloadDependency::DbDependencies;
-    using DependenciesMap = std::unordered_map<Package, DownloadDependency>;
-
 public:
     PackagesDatabase();
 
-    IdDependencies findDependencies(const Packages &deps) const;
+    // if 'failed' is set, packages that cannot be resolved are put there
+    // instead of throwing an exception
+    DependencyGraph findDependencies(const Packages &deps, Packages *failed = nullptr) const;
 
     void listPackages(const String &name = String()) const;
 
@@ -170,8 +188,11 @@ private:
 
     bool isCurrentDbOld() const;
 
+    void findDependencies(const Package &dep, DependencyGraph &g) const;
     ProjectVersionId getExactProjectVersionId(const DownloadDependency &project, Version &version, ProjectFlags &flags, String &hash) const;
-    Dependencies getProjectDependencies(ProjectVersionId project_version_id, DependenciesMap &dm) const;
+    // 'requested' receives requested versions of dependencies
+    std::vector<DependencyGraph::NodeId> getProjectDependencies(ProjectVersionId project_version_id, DependencyGraph &g,
+        std::vector<Version> *requested = nullptr) const;
 };
 
 ServiceDatabase &getServiceDatabase(bool init = true);
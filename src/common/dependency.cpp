@@ -16,21 +16,248 @@
 
 #include "dependency.h"
 
+#include <algorithm>
+#include <optional>
+
 void DownloadDependency::setDependencyIds(const std::unordered_set<ProjectVersionId> &ids)
 {
     id_dependencies = ids;
 }
 
-void DownloadDependency::prepareDependencies(const IdDependencies &dd)
+DependencyGraph::DependencyGraph(const IdDependencies &id_deps)
 {
-    for (auto d : id_dependencies)
+    std::unordered_map<ProjectVersionId, NodeId> ids;
+    for (auto &[id, d] : id_deps)
+        ids[id] = add(d);
+    for (auto &[id, d] : id_deps)
     {
-        auto i = dd.find(d);
-        if (i == dd.end())
-            throw std::runtime_error("cannot find dep by id");
-        auto dep = i->second;
-        dep.createNames();
-        dependencies[dep] = dep;
+        auto n = ids[id];
+        for (auto dep : d.getDependencyIds())
+        {
+            auto i = ids.find(dep);
+            if (i == ids.end())
+                throw std::runtime_error("cannot find dep by id");
+            if (i->second != n) // skip self
+                nodes[n].dependencies.push_back(i->second);
+        }
     }
-    dependencies.erase(*this); // erase self
+}
+
+DependencyGraph::NodeId DependencyGraph::add(const ExtendedPackageData &d)
+{
+    auto i = index.try_emplace(getPackageId(d), (NodeId)nodes.size());
+    auto id = i.first->second;
+    if (i.second)
+        nodes.emplace_back();
+    else if (checkpoint_size && id < *checkpoint_size)
+        replaced.try_emplace(id, nodes[id]);
+    static_cast<ExtendedPackageData &>(nodes[id]) = d;
+    return id;
+}
+
+std::optional<DependencyGraph::NodeId> DependencyGraph::find(const Package &p) const
+{
+    auto i = index.find(getPackageId(p));
+    if (i == index.end())
+        return {};
+    return i->second;
+}
+
+void DependencyGraph::merge(const DependencyGraph &g)
+{
+    std::vector<NodeId> ids;
+    ids.reserve(g.size());
+    for (auto &n : g)
+        ids.push_back(add(n));
+    for (size_t i = 0; i < g.size(); i++)
+    {
+        auto &n = nodes[ids[i]];
+        n.dependencies.clear();
+        for (auto d : g.nodes[i].dependencies)
+            n.dependencies.push_back(ids[d]);
+        n.requested_versions = g.nodes[i].requested_versions;
+    }
+}
+
+void DependencyGraph::checkpoint()
+{
+    checkpoint_size = nodes.size();
+    replaced.clear();
+}
+
+void DependencyGraph::rollback()
+{
+    if (!checkpoint_size)
+        return;
+    for (auto i = *checkpoint_size; i < nodes.size(); i++)
+        index.erase(getPackageId(nodes[i]));
+    nodes.resize(*checkpoint_size);
+    for (auto &[id, n] : replaced)
+        nodes[id] = std::move(n);
+    commit();
+}
+
+void DependencyGraph::commit()
+{
+    checkpoint_size.reset();
+    replaced.clear();
+}
+
+size_t DependencyGraph::unify_versions(const Packages &direct)
+{
+    auto satisfies = [](const Version &requested, const Version &v)
+    {
+        // canBe() does not check branches
+        if (requested.isBranch() || v.isBranch())
+            return requested == v;
+        return requested.canBe(v);
+    };
+
+    // versions requested from every node
+    std::vector<std::vector<Version>> requests(nodes.size());
+    for (auto &n : nodes)
+    {
+        for (size_t i = 0; i < n.dependencies.size(); i++)
+        {
+            auto d = n.dependencies[i];
+            requests[d].push_back(n.requested_versions.size() == n.dependencies.size() ? n.requested_versions[i] : nodes[d].version);
+        }
+    }
+    std::vector<NodeId> roots;
+    for (NodeId i = 0; i < nodes.size(); i++)
+    {
+        if (!nodes[i].flags[pfDirectDependency])
+            continue;
+        roots.push_back(i);
+        bool found = false;
+        for (auto &[_, p] : direct)
+        {
+            if (p.ppath == nodes[i].ppath || p.ppath.is_root_of(nodes[i].ppath))
+            {
+                requests[i].push_back(p.version);
+                found = true;
+            }
+        }
+        if (!found)
+            requests[i].push_back(nodes[i].version);
+    }
+
+    std::unordered_map<ProjectPath, std::vector<NodeId>> projects;
+    for (NodeId i = 0; i < nodes.size(); i++)
+        projects[nodes[i].ppath].push_back(i);
+
+    // replaced node -> its replacement
+    std::vector<NodeId> replacement(nodes.size());
+    for (NodeId i = 0; i < nodes.size(); i++)
+        replacement[i] = i;
+    bool replaced = false;
+    for (auto &[ppath, ids] : projects)
+    {
+        if (ids.size() < 2)
+            continue;
+
+        std::optional<NodeId> best;
+        for (auto id : ids)
+        {
+            auto &v = nodes[id].version;
+            if (best && v < nodes[*best].version)
+                continue;
+            bool ok = std::all_of(ids.begin(), ids.end(), [&requests, &satisfies, &v](auto id2)
+            {
+                return std::all_of(requests[id2].begin(), requests[id2].end(), [&satisfies, &v](auto &r)
+                {
+                    return satisfies(r, v);
+                });
+            });
+            if (ok)
+                best = id;
+        }
+        if (!best)
+            continue;
+
+        for (auto id : ids)
+        {
+            if (id == *best)
+                continue;
+            replacement[id] = *best;
+            if (nodes[id].flags[pfDirectDependency])
+                nodes[*best].flags.set(pfDirectDependency);
+            replaced = true;
+        }
+    }
+    if (!replaced)
+        return 0;
+
+    auto reachable = [this](std::vector<NodeId> q, const std::vector<NodeId> &map)
+    {
+        std::vector<char> r(nodes.size());
+        while (!q.empty())
+        {
+            auto i = map[q.back()];
+            q.pop_back();
+            if (r[i])
+                continue;
+            r[i] = 1;
+            for (auto d : nodes[i].dependencies)
+                q.push_back(d);
+        }
+        return r;
+    };
+
+    // remove replaced nodes and nodes that were used only by them,
+    // nodes unreachable from the start are kept
+    std::vector<NodeId> identity(nodes.size());
+    for (NodeId i = 0; i < nodes.size(); i++)
+        identity[i] = i;
+    auto before = reachable(roots, identity);
+    for (NodeId i = 0; i < nodes.size(); i++)
+    {
+        if (!before[i])
+            roots.push_back(i);
+    }
+    auto after = reachable(roots, replacement);
+
+    std::vector<NodeId> new_ids(nodes.size());
+    std::vector<Node> new_nodes;
+    for (NodeId i = 0; i < nodes.size(); i++)
+    {
+        if (!after[i])
+            continue;
+        new_ids[i] = (NodeId)new_nodes.size();
+        new_nodes.push_back(std::move(nodes[i]));
+    }
+    auto removed = nodes.size() - new_nodes.size();
+
+    for (NodeId id = 0; id < new_nodes.size(); id++)
+    {
+        auto &n = new_nodes[id];
+        std::vector<NodeId> deps;
+        std::vector<Version> requested;
+        bool has_requested = n.requested_versions.size() == n.dependencies.size();
+        for (size_t i = 0; i < n.dependencies.size(); i++)
+        {
+            auto d = new_ids[replacement[n.dependencies[i]]];
+            // both versions were used
+            if (d == id || std::find(deps.begin(), deps.end(), d) != deps.end())
+                continue;
+            deps.push_back(d);
+            if (has_requested)
+                requested.push_back(n.requested_versions[i]);
+        }
+        n.dependencies = std::move(deps);
+        n.requested_versions = std::move(requested);
+    }
+
+    nodes = std::move(new_nodes);
+    index.clear();
+    for (NodeId i = 0; i < nodes.size(); i++)
+        index[getPackageId(nodes[i])] = i;
+    return removed;
+}
+
+void DependencyGraph::clear()
+{
+    nodes.clear();
+    index.clear();
+    commit();
 }
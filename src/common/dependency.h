@@ -16,11 +16,14 @@
 
 #pragma once
 
+#include "cppan_archive.h"
 #include "cppan_string.h"
 #include "package.h"
 
+#include <optional>
 #include <unordered_map>
 #include <unordered_set>
+#include <vector>
 
 struct Remote;
 
@@ -29,23 +32,88 @@ struct ExtendedPackageData : Package
     ProjectVersionId id = 0;
     String hash;
     const Remote *remote = nullptr;
+
+    // preferred archive for download, hash is the hash of archive in this format
+    // ('hash' is always the hash of tar.gz archive)
+    ArchiveFormat archive_format = ArchiveFormat::TarGz;
+    String archive_hash;
 };
 
+// package with ids of its dependencies as they come from the server
 struct DownloadDependency : ExtendedPackageData
 {
     using IdDependencies = std::unordered_map<ProjectVersionId, DownloadDependency>;
-    using DbDependencies = std::unordered_map<String, ExtendedPackageData>;
-    using Dependencies = std::unordered_map<Package, ExtendedPackageData>;
-
-    // own data (private)
-    DbDependencies db_dependencies;
-    Dependencies dependencies;
 
     void setDependencyIds(const std::unordered_set<ProjectVersionId> &ids);
-    void prepareDependencies(const IdDependencies &dd);
+    const std::unordered_set<ProjectVersionId> &getDependencyIds() const { return id_dependencies; }
 
 private:
     std::unordered_set<ProjectVersionId> id_dependencies;
 };
 
 using IdDependencies = DownloadDependency::IdDependencies;
+
+// Resolved dependencies. Every package is stored once in the node table,
+// edges are lists of node ids, so size grows with packages + edges only.
+class DependencyGraph
+{
+public:
+    using NodeId = uint32_t;
+
+    struct Node : ExtendedPackageData
+    {
+        // direct dependencies
+        std::vector<NodeId> dependencies;
+        // versions requested for dependencies (in the same order),
+        // empty when unknown (server sends resolved versions only)
+        std::vector<Version> requested_versions;
+    };
+
+    using iterator = std::vector<Node>::iterator;
+    using const_iterator = std::vector<Node>::const_iterator;
+
+public:
+    DependencyGraph() = default;
+    // edges are taken from dependency ids
+    DependencyGraph(const IdDependencies &id_deps);
+
+    // adds the package or replaces data of the same package (edges are kept)
+    NodeId add(const ExtendedPackageData &d);
+    std::optional<NodeId> find(const Package &p) const;
+
+    // nodes of g replace nodes of the same packages together with their edges
+    void merge(const DependencyGraph &g);
+
+    // Changes made by add() after checkpoint() are undone by rollback():
+    // added nodes are removed, replaced nodes are restored with their edges.
+    // Edges of other old nodes must not be changed in between. commit() drops the undo data.
+    void checkpoint();
+    void rollback();
+    void commit();
+
+    // Leaves one version of a project - the highest one that satisfies all requests
+    // of its dependents ('direct' - requested packages), edges are rewritten to it.
+    // Unknown requests are exact versions. Packages used only by removed ones are removed too.
+    // Returns number of removed packages.
+    size_t unify_versions(const Packages &direct);
+
+    Node &operator[](NodeId id) { return nodes[id]; }
+    const Node &operator[](NodeId id) const { return nodes[id]; }
+
+    iterator begin() { return nodes.begin(); }
+    iterator end() { return nodes.end(); }
+    const_iterator begin() const { return nodes.begin(); }
+    const_iterator end() const { return nodes.end(); }
+
+    bool empty() const { return nodes.empty(); }
+    size_t size() const { return nodes.size(); }
+    void clear();
+
+private:
+    std::vector<Node> nodes;
+    std::unordered_map<PackageId, NodeId> index;
+
+    // undo data
+    std::optional<size_t> checkpoint_size;
+    std::unordered_map<NodeId, Node> replaced;
+};
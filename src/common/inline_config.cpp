@@ -0,0 +1,150 @@
+/*
+ * Copyright (C) 2016-2017, Egor Pugin
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "inline_config.h"
+
+#include "directories.h"
+#include "hash.h"
+
+#include <boost/algorithm/string.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+
+#define INLINE_CONFIGS_CACHE_VERSION 1
+
+bool is_inline_config(const yaml &root)
+{
+    return root.IsMap() && (
+        root["local_settings"].IsDefined() ||
+        root["files"].IsDefined() ||
+        root["dependencies"].IsDefined()
+        );
+}
+
+// same rules as in comments lexer (extract_comments()):
+// whitespace, preprocessor lines and '//' comments are skipped,
+// any other symbol is the start of code
+Strings extract_inline_configs(const char *p, const char *end)
+{
+    auto skip_line = [&p, end]
+    {
+        while (p != end && *p != '\n')
+            p++;
+    };
+
+    // utf-8 bom
+    if (end - p >= 3 && memcmp(p, "\xEF\xBB\xBF", 3) == 0)
+        p += 3;
+
+    Strings comments;
+    while (p != end)
+    {
+        switch (*p)
+        {
+        case ' ': case '\t': case '\r': case '\n':
+            p++;
+            continue;
+        case '#':
+            skip_line();
+            continue;
+        case '/':
+            if (end - p >= 2 && p[1] == '/')
+            {
+                skip_line();
+                continue;
+            }
+            if (end - p >= 2 && p[1] == '*')
+            {
+                static const String eoc = "*/";
+                auto b = p + 2;
+                auto e = std::search(b, end, eoc.begin(), eoc.end());
+                if (e == end)
+                    return comments; // unterminated
+                comments.emplace_back(b, e);
+                p = e + 2;
+
+                try
+                {
+                    auto s = boost::trim_copy(comments.back());
+                    if (is_inline_config(load_yaml_config(s)))
+                        return comments;
+                }
+                catch (...)
+                {
+                }
+                continue;
+            }
+            return comments;
+        default:
+            return comments;
+        }
+    }
+    return comments;
+}
+
+Strings read_inline_configs(const path &fn)
+{
+    auto size = fs::file_size(fn);
+    auto t = fs::last_write_time(fn);
+    auto mtime = t.time_since_epoch().count();
+    auto cache_fn = directories.storage_dir_etc / STAMPS_DIR / "inline_configs" / sha256_short(normalize_path(fn));
+
+    // format: 'version size mtime', then comments as 'length\ndata'
+    {
+        std::ifstream ifile(cache_fn, std::ios::binary);
+        int v;
+        uintmax_t sz;
+        fs::file_time_type::rep mt;
+        if (ifile >> v >> sz >> mt && v == INLINE_CONFIGS_CACHE_VERSION && sz == size && mt == mtime)
+        {
+            Strings comments;
+            bool ok = true;
+            size_t len;
+            while (ok && ifile >> len && ifile.get() == '\n')
+            {
+                String s(len, 0);
+                ok = !len || ifile.read(&s[0], len);
+                comments.push_back(std::move(s));
+            }
+            if (ok && ifile.eof())
+                return comments;
+        }
+    }
+
+    MappedFile f(fn);
+    auto comments = extract_inline_configs(f.begin(), f.end());
+
+    // mtime of recently changed file is not reliable (fs timestamp resolution)
+    if (t > fs::file_time_type::clock::now() - std::chrono::seconds(2))
+        return comments;
+
+    String s = std::to_string(INLINE_CONFIGS_CACHE_VERSION) + " " + std::to_string(size) + " " + std::to_string(mtime) + "\n";
+    for (auto &c : comments)
+        s += std::to_string(c.size()) + "\n" + c;
+
+    // other processes may read it at the same time
+    fs::create_directories(cache_fn.parent_path());
+    auto tmp = path(cache_fn) += "." + unique_path().string();
+    write_file(tmp, s);
+    error_code ec;
+    fs::rename(tmp, cache_fn, ec);
+    if (ec)
+        fs::remove(tmp, ec);
+    return comments;
+}
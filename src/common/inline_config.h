@@ -0,0 +1,34 @@
+/*
+ * Copyright (C) 2016-2017, Egor Pugin
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "cppan_string.h"
+#include "filesystem.h"
+#include "yaml.h"
+
+// Inline configs are '/* ... */' comments at the beginning of source file
+// (before the first line of code), like in 'cppan --build file.cpp'.
+
+// true when yaml has keys used only in cppan configs
+bool is_inline_config(const yaml &root);
+
+// Extracts leading comments, stops after the first one that looks like cppan config.
+Strings extract_inline_configs(const char *begin, const char *end);
+
+// Same for file. File is mapped, not read,
+// result is cached by file size and mtime.
+Strings read_inline_configs(const path &fn);
@@ -24,6 +24,7 @@
 
 #include <boost/algorithm/string.hpp>
 
+#include <deque>
 #include <regex>
 #include <shared_mutex>
 
@@ -65,9 +66,8 @@ String Package::getStampHash() const
 
 String Package::getHash() const
 {
-    static const auto delim = "/";
     if (hash.empty())
-        return sha256(ppath.toString() + delim + version.toString());
+        return getPackage(getPackageId(*this)).hash;
     return hash;
 }
 
@@ -83,16 +83,32 @@ String Package::getFilesystemHash() const
 
 path Package::getHashPath() const
 {
-    auto h = getFilesystemHash();
-    path p;
-    p /= h.substr(0, 2);
-    p /= h.substr(2, 2);
-    p /= h.substr(4);
-    return p;
+    if (hash_path.empty())
+        return getPackage(getPackageId(*this)).hash_path;
+    return hash_path;
 }
 
 void Package::createNames()
 {
+    auto &ip = getPackage(getPackageId(*this));
+    target_name = ip.target_name;
+    target_name_hash = ip.target_name_hash;
+    variable_name = ip.variable_name;
+    variable_no_version_name = ip.variable_no_version_name;
+    hash = ip.hash;
+    hash_path = ip.hash_path;
+}
+
+void Package::deriveNames()
+{
+    static const auto delim = "/";
+    hash = sha256(ppath.toString() + delim + version.toString());
+
+    auto h = getFilesystemHash();
+    hash_path /= h.substr(0, 2);
+    hash_path /= h.substr(2, 2);
+    hash_path /= h.substr(4);
+
     auto v = version.toAnyVersion();
 
     target_name = ppath.toString() + (v == "*" ? "" : ("-" + v));
@@ -110,16 +126,12 @@ void Package::createNames()
     std::replace(variable_no_version_name.begin(), variable_no_version_name.end(), '.', '_');
 
     target_name_hash = getHashShort();
-    hash = getHash();
 }
 
 String Package::getTargetName() const
 {
     if (target_name.empty())
-    {
-        auto v = version.toAnyVersion();
-        return ppath.toString() + (v == "*" ? "" : ("-" + v));
-    }
+        return getPackage(getPackageId(*this)).target_name;
     return target_name;
 }
 
@@ -135,6 +147,62 @@ String Package::getVariableName() const
     return variable_name;
 }
 
+namespace
+{
+
+struct PackageIds
+{
+    std::shared_mutex m;
+    std::unordered_map<Package, PackageId> ids;
+    std::deque<Package> packages; // references must be stable
+};
+
+PackageIds &getPackageIds()
+{
+    static PackageIds pi;
+    return pi;
+}
+
+}
+
+PackageId getPackageId(const Package &p)
+{
+    auto &pi = getPackageIds();
+    {
+        std::shared_lock<std::shared_mutex> lk(pi.m);
+        auto i = pi.ids.find(p);
+        if (i != pi.ids.end())
+            return i->second;
+    }
+
+    Package ip;
+    ip.ppath = p.ppath;
+    ip.version = p.version;
+    ip.deriveNames();
+
+    std::unique_lock<std::shared_mutex> lk(pi.m);
+    auto i = pi.ids.emplace(ip, (PackageId)pi.packages.size());
+    if (i.second)
+        pi.packages.push_back(std::move(ip));
+    return i.first->second;
+}
+
+const Package &getPackage(PackageId id)
+{
+    auto &pi = getPackageIds();
+    std::shared_lock<std::shared_mutex> lk(pi.m);
+    if (id >= pi.packages.size())
+        throw std::logic_error("Bad package id: " + std::to_string(id));
+    return pi.packages[id];
+}
+
+size_t getNumberOfPackageIds()
+{
+    auto &pi = getPackageIds();
+    std::shared_lock<std::shared_mutex> lk(pi.m);
+    return pi.packages.size();
+}
+
 Package extractFromString(const String &target)
 {
     auto pos = target.rfind('-');
@@ -208,14 +276,14 @@ void cleanPackages(const String &s, int flags)
 
 void cleanPackage(const Package &pkg, int flags)
 {
-    static std::unordered_map<Package, int> cleaned_packages;
+    static std::unordered_map<PackageId, int> cleaned_packages;
     static std::shared_mutex m;
 
-    static const auto cache_dir_bin = enumerate_files(directories.storage_dir_bin);
-    static const auto cache_dir_exp = enumerate_files(directories.storage_dir_exp);
-    static const auto cache_dir_lib = enumerate_files(directories.storage_dir_lib);
+    static const auto cache_dir_bin = enumerate_files_parallel(directories.storage_dir_bin);
+    static const auto cache_dir_exp = enumerate_files_parallel(directories.storage_dir_exp);
+    static const auto cache_dir_lib = enumerate_files_parallel(directories.storage_dir_lib);
 #ifdef _WIN32
-    static const auto cache_dir_lnk = enumerate_files(directories.storage_dir_lnk);
+    static const auto cache_dir_lnk = enumerate_files_parallel(directories.storage_dir_lnk);
 #endif
 
     auto &sdb = getServiceDatabase();
@@ -225,9 +293,10 @@ void cleanPackage(const Package &pkg, int flags)
         return;
 
     // only clean yet uncleaned flags
+    auto id = getPackageId(pkg);
     {
         std::shared_lock<std::shared_mutex> lock(m);
-        auto i = cleaned_packages.find(pkg);
+        auto i = cleaned_packages.find(id);
         if (i != cleaned_packages.end())
             flags &= ~i->second;
         if (flags == 0)
@@ -237,7 +306,7 @@ void cleanPackage(const Package &pkg, int flags)
     // save cleaned packages
     {
         std::unique_lock<std::shared_mutex> lock(m);
-        auto &f = cleaned_packages[pkg];
+        auto &f = cleaned_packages[id];
         flags &= ~f;
         f |= flags;
 
@@ -26,6 +26,10 @@
 
 #include <map>
 
+// Dense id of the distinct package (ppath + version), ids are valid for the whole run.
+// Use it as a key of big maps instead of Package, names are needed only for output.
+using PackageId = uint32_t;
+
 struct Package
 {
     ProjectPath ppath;
@@ -57,6 +61,7 @@ struct Package
     String variable_name;
     String variable_no_version_name;
 
+    // copies names from the interned package
     void createNames();
     String getTargetName() const;
     String getVariableName() const;
@@ -64,14 +69,27 @@ struct Package
 private:
     // cached vars
     String hash;
+    path hash_path;
 
     path getDir(const path &p) const;
+    // computes names and hashes, done once per identity in the interner
+    void deriveNames();
+
+    friend PackageId getPackageId(const Package &p);
 };
 
 using Packages = std::unordered_map<String, Package>;
-using PackagesMap = std::unordered_map<Package, Package>;
 using PackagesSet = std::unordered_set<Package>;
 
+// global interner, thread safe
+// interned packages have only ppath, version, names and hashes (no flags etc.)
+PackageId getPackageId(const Package &p);
+const Package &getPackage(PackageId id);
+size_t getNumberOfPackageIds();
+
+// requested package -> resolved package (with flags)
+using PackagesMap = std::unordered_map<PackageId, Package>;
+
 Package extractFromString(const String &target);
 Package extractFromStringAny(const String &target);
 
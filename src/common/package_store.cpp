@@ -18,19 +18,21 @@
 
 #include "access_table.h"
 #include "config.h"
+#include "config_cache.h"
 #include "database.h"
 #include "directories.h"
 #include "exceptions.h"
 #include "hash.h"
+#include "inline_config.h"
 #include "lock.h"
 #include "project.h"
 #include "resolver.h"
+#include "scheduler.h"
 #include "settings.h"
 #include "sqlite_database.h"
 
 #include <boost/algorithm/string.hpp>
 
-#include <primitives/executor.h>
 #include <primitives/hasher.h>
 #include <primitives/http.h>
 #include <primitives/templates.h>
@@ -44,8 +46,6 @@
 // legacy varname rd - was: response data
 PackageStore rd;
 
-Strings extract_comments(const String &s);
-
 void download_file(path &fn)
 {
     // this function checks if fn is url,
@@ -72,13 +72,13 @@ void PackageStore::process(const path &p, Config &root)
     AccessTable access_table;
 
     // insert root config
-    packages[root.pkg].config = &root;
+    (*this)[root.pkg].config = &root;
 
     // resolve deps
     for (auto &c : packages)
     {
         if (!c.second.config)
-            throw std::runtime_error("Config was not created for target: " + c.first.target_name);
+            throw std::runtime_error("Config was not created for target: " + c.second.package.target_name);
 
         resolve_dependencies(*c.second.config);
     }
@@ -86,14 +86,15 @@ void PackageStore::process(const path &p, Config &root)
     // set correct local package flags to rd[d].dependencies
     for (auto &c : packages)
     {
-        if (!c.first.flags[pfLocalProject])
+        auto &p = c.second.package;
+        if (!p.flags[pfLocalProject])
             continue;
         // only for local packages!!!
         for (auto &d : c.second.dependencies)
         {
             // i->first equals to d.second but have correct flags!!!
             // so we assign them to d.second
-            auto i = packages.find(d.second);
+            auto i = find(d.second);
             if (i == packages.end())
             {
                 // for pretty error message
@@ -103,22 +104,23 @@ void PackageStore::process(const path &p, Config &root)
                 // we try to resolve again
                 ::resolve_dependencies({ d });
 
-                auto irp = resolved_packages.find(d.second);
+                auto irp = resolved_packages.find(getPackageId(d.second));
                 if (irp == resolved_packages.end())
-                    throw std::runtime_error(c.first.target_name + ": cannot find match for " + dep.target_name);
+                    throw std::runtime_error(p.target_name + ": cannot find match for " + dep.target_name);
 
-                i = packages.find(irp->second);
+                i = find(irp->second);
                 if (i == packages.end())
                 {
                     throw std::logic_error("resolved package does not exist in packages var! " +
-                        c.first.target_name + ": cannot find match for " + dep.target_name);
+                        p.target_name + ": cannot find match for " + dep.target_name);
                 }
             }
             if (!d.second.ppath.is_loc())
                 continue;
-            bool ido = d.second.flags[pfIncludeDirectoriesOnly] | i->first.flags[pfIncludeDirectoriesOnly];
-            bool pvt = d.second.flags[pfPrivateDependency] | i->first.flags[pfPrivateDependency];
-            d.second.flags = i->first.flags;
+            auto &ip = i->second.package;
+            bool ido = d.second.flags[pfIncludeDirectoriesOnly] | ip.flags[pfIncludeDirectoriesOnly];
+            bool pvt = d.second.flags[pfPrivateDependency] | ip.flags[pfPrivateDependency];
+            d.second.flags = ip.flags;
             d.second.flags.set(pfIncludeDirectoriesOnly, ido);
             d.second.flags.set(pfPrivateDependency, pvt);
         }
@@ -143,7 +145,7 @@ void PackageStore::process(const path &p, Config &root)
     // add more necessary actions here
     for (auto &cc : *this)
     {
-        if (cc.first == Package())
+        if (cc.second.package == Package())
             continue;
         root.getDefaultProject().checks += cc.second.config->getDefaultProject().checks;
     }
@@ -154,9 +156,9 @@ void PackageStore::process(const path &p, Config &root)
     // do not multithread this! causes livelocks
     for (auto &cc : *this)
     {
-        if (cc.first == Package())
+        if (cc.second.package == Package())
             continue;
-        auto &d = cc.first;
+        auto &d = cc.second.package;
 
         auto printer = Printer::create(Settings::get_local_settings().printerType);
         printer->access_table = &access_table;
@@ -183,7 +185,8 @@ void PackageStore::resolve_dependencies(const Config &c)
     if (c.getProjects().size() > 1)
         throw std::runtime_error("Make sure your config has only one project (call split())");
 
-    if (!packages[c.pkg].dependencies.empty())
+    auto &pc = (*this)[c.pkg];
+    if (!pc.dependencies.empty())
         return;
 
     Packages deps;
@@ -195,16 +198,16 @@ void PackageStore::resolve_dependencies(const Config &c)
         if (d.second.ppath.is_loc())
         {
             // but still insert as a dependency
-            packages[c.pkg].dependencies.insert(d);
+            pc.dependencies.insert(d);
             continue;
         }
 
         // remove already downloaded packages
-        auto i = resolved_packages.find(d.second);
+        auto i = resolved_packages.find(getPackageId(d.second));
         if (i != resolved_packages.end())
         {
             // but still insert as a dependency
-            packages[c.pkg].dependencies.insert({ i->second.ppath.toString(), i->second });
+            pc.dependencies.insert({ i->second.ppath.toString(), i->second });
             continue;
         }
 
@@ -232,10 +235,10 @@ void PackageStore::check_deps_changed()
     // now refresh dependencies database only for remote packages
     // this file (local,current,root) packages will be refreshed anyway
     auto &sdb = getServiceDatabase();
-    std::unordered_map<Package, String> clean_pkgs;
+    std::vector<std::pair<Package, String>> clean_pkgs;
     for (auto &cc : *this)
     {
-        if (cc.first == Package())
+        if (cc.second.package == Package())
             continue;
         // make sure we have ordered deps
         Hasher h;
@@ -245,32 +248,28 @@ void PackageStore::check_deps_changed()
         for (auto &d : deps)
             h |= d;
 
-        if (!sdb.hasPackageDependenciesHash(cc.first, h.hash))
+        if (!sdb.hasPackageDependenciesHash(cc.second.package, h.hash))
         {
             deps_changed = true;
 
             // clear exports for this project, so it will be regenerated
             auto p = Printer::create(Settings::get_local_settings().printerType);
-            p->clear_export(cc.first.getDirObj());
-            clean_pkgs.emplace(cc.first, h.hash);
+            p->clear_export(cc.second.package.getDirObj());
+            clean_pkgs.emplace_back(cc.second.package, h.hash);
         }
     }
 
-    auto &e = getExecutor();
-    std::vector<Future<void>> fs;
+    TaskGroup g(Scheduler::Io);
     for (auto &kv : clean_pkgs)
     {
-        fs.push_back(e.push([&kv, &sdb]
+        g.push([&kv, &sdb]
         {
             cleanPackages(kv.first.target_name, CleanTarget::Lib | CleanTarget::Bin | CleanTarget::Obj | CleanTarget::Exp);
             // set dep hash only after clean
             sdb.setPackageDependenciesHash(kv.first, kv.second);
-        }));
+        });
     }
-    for (auto &f : fs)
-        f.wait();
-    for (auto &f : fs)
-        f.get();
+    g.wait();
 }
 
 PackageStore::iterator PackageStore::begin()
@@ -295,17 +294,28 @@ PackageStore::const_iterator PackageStore::end() const
 
 PackageStore::PackageConfig &PackageStore::operator[](const Package &p)
 {
-    return packages[p];
+    auto i = packages.try_emplace(getPackageId(p));
+    if (i.second)
+        i.first->second.package = p;
+    return i.first->second;
 }
 
 const PackageStore::PackageConfig &PackageStore::operator[](const Package &p) const
 {
-    auto i = packages.find(p);
+    auto i = find(p);
     if (i == packages.end())
         throw std::runtime_error("Package not found: " + p.getTargetName());
     return i->second;
 }
 
+const PackageStore::PackageConfig &PackageStore::operator[](PackageId id) const
+{
+    auto i = packages.find(id);
+    if (i == packages.end())
+        throw std::runtime_error("Package not found: " + getPackage(id).target_name);
+    return i->second;
+}
+
 void PackageStore::write_index() const
 {
 #ifdef _WIN32
@@ -319,36 +329,40 @@ void PackageStore::write_index() const
     auto &sdb = getServiceDatabase();
     for (auto &cc : *this)
     {
-        if (cc.first == Package())
+        if (cc.second.package == Package())
             continue;
-        sdb.addInstalledPackage(cc.first);
+        sdb.addInstalledPackage(cc.second.package);
 #ifdef _WIN32
-        create_link(cc.first.getDirSrc(), directories.storage_dir_lnk / "src" / (cc.first.target_name + ".lnk"));
-        create_link(cc.first.getDirObj(), directories.storage_dir_lnk / "obj" / (cc.first.target_name + ".lnk"));
+        create_link(cc.second.package.getDirSrc(), directories.storage_dir_lnk / "src" / (cc.second.package.target_name + ".lnk"));
+        create_link(cc.second.package.getDirObj(), directories.storage_dir_lnk / "obj" / (cc.second.package.target_name + ".lnk"));
 #endif
     }
 }
 
-Config *PackageStore::add_config(std::unique_ptr<Config> &&config, bool created)
+Config *PackageStore::add_config(Config &&config, bool created)
 {
-    auto cfg = config.get();
-    auto i = config_store.insert(std::move(config));
-    packages[cfg->pkg].config = i.first->get();
-    packages[cfg->pkg].config->created = created;
-    return packages[cfg->pkg].config;
+    auto &c = config_store.emplace_back(std::move(config));
+    auto &pc = (*this)[c.pkg];
+    pc.config = &c;
+    pc.config->created = created;
+    return pc.config;
 }
 
 Config *PackageStore::add_config(const Package &p, bool local)
 {
-    auto c = std::make_unique<Config>(p.getDirSrc(), local);
+    // downloaded packages never change
+    std::unique_ptr<Config> c;
+    if (local || p.flags[pfLocalProject])
+        c = std::make_unique<Config>(p.getDirSrc(), local);
+    else
+        c = load_config_cached(p.getDirSrc());
     c->setPackage(p);
-    return add_config(std::move(c), true);
+    return add_config(std::move(*c), true);
 }
 
-Config *PackageStore::add_local_config(const Config &co)
+Config *PackageStore::add_local_config(Config &&co)
 {
-    auto cu = std::make_unique<Config>(co);
-    auto cp = add_config(std::move(cu), true);
+    auto cp = add_config(std::move(co), true);
     resolve_dependencies(*cp);
     return cp;
 }
@@ -370,8 +384,7 @@ PackageStore::read_packages_from_file(path p, const String &config_name, bool di
 
     auto read_from_cpp = [&conf, &config_name](const path &fn)
     {
-        auto s = read_file_without_bom(fn);
-        auto comments = extract_comments(s);
+        auto comments = read_inline_configs(fn);
 
         std::vector<size_t> load_ok;
         bool found = false;
@@ -387,11 +400,7 @@ PackageStore::read_packages_from_file(path p, const String &config_name, bool di
                 if (sz == 0)
                     continue;
 
-                probably_this = root.IsMap() && (
-                    root["local_settings"].IsDefined() ||
-                    root["files"].IsDefined() ||
-                    root["dependencies"].IsDefined()
-                    );
+                probably_this = is_inline_config(root);
 
                 if (!config_name.empty())
                     root["local_settings"]["current_build"] = config_name;
@@ -557,11 +566,11 @@ PackageStore::read_packages_from_file(path p, const String &config_name, bool di
         local_packages[pkg.ppath] = root_directory;
     }
 
-    Executor e(std::thread::hardware_concurrency() * 2);
-    std::vector<Future<void>> fs;
+    // finding sources is bound by file system calls
+    TaskGroup g(Scheduler::Io);
     for (auto &c : configs)
     {
-        auto f = e.push([&c, &p, &cpp_fn, &ppath]()
+        g.push([&c, &p, &cpp_fn, &ppath]()
         {
             auto &project = c.getDefaultProject();
             auto root_directory = fs::is_regular_file(p) ? p.parent_path() : p;
@@ -594,15 +603,16 @@ PackageStore::read_packages_from_file(path p, const String &config_name, bool di
 
             if (Settings::get_local_settings().install_local_packages)
             {
-                // copy files to project's dir
+                // sync files to project's dir, unchanged files are not copied
                 decltype(project.files) files;
+                std::map<path, path> copy;
                 for (auto &f : project.files)
                 {
                     auto r = project.pkg.getDirSrc() / f.lexically_relative(root_directory);
-                    create_directories(r.parent_path());
-                    fs::copy_file(f, r, fs::copy_options::overwrite_existing);
+                    copy[f] = r;
                     files.insert(r);
                 }
+                sync_files(copy, project.pkg.getDirSrc(), path(project.pkg.getStampFilename()) += ".files");
                 project.files = files;
 
                 // set non local
@@ -625,12 +635,8 @@ PackageStore::read_packages_from_file(path p, const String &config_name, bool di
                 project.dependencies.insert({ d.second.ppath.toString(), d.second });
             }
         });
-        fs.push_back(f);
     }
-    for (auto &f : fs)
-        f.wait();
-    for (auto &f : fs)
-        f.get();
+    g.wait();
 
     // seq
     for (auto &c : configs)
@@ -641,7 +647,7 @@ PackageStore::read_packages_from_file(path p, const String &config_name, bool di
         packages.insert(project.pkg);
 
         // add config to storage
-        rd.add_local_config(c);
+        rd.add_local_config(std::move(c));
     }
 
     // write local packages to index
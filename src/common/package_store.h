@@ -16,12 +16,13 @@
 
 #pragma once
 
+#include "config.h"
 #include "cppan_string.h"
 #include "dependency.h"
 
+#include <deque>
 #include <optional>
 
-struct Config;
 class ProjectPath;
 
 class PackageStore
@@ -29,13 +30,15 @@ class PackageStore
 public:
     struct PackageConfig
     {
-        Config *config;
+        // package as it was added (with flags)
+        Package package;
+        Config *config = nullptr;
         Packages dependencies;
 
         // cache
         std::optional<StringMap<Package>> include_script_deps;
     };
-    using PackageConfigs = std::unordered_map<Package, PackageConfig>;
+    using PackageConfigs = std::unordered_map<PackageId, PackageConfig>;
 
     using iterator = PackageConfigs::iterator;
     using const_iterator = PackageConfigs::const_iterator;
@@ -48,9 +51,9 @@ public:
     path get_local_package_dir(const ProjectPath &ppath) const;
     void process(const path &p, Config &root);
 
-    Config *add_config(std::unique_ptr<Config> &&config, bool created);
+    Config *add_config(Config &&config, bool created);
     Config *add_config(const Package &p, bool local = true);
-    Config *add_local_config(const Config &c);
+    Config *add_local_config(Config &&c);
 
     bool rebuild_configs() const { return has_downloads() || deps_changed; }
     bool has_downloads() const { return downloads > 0; }
@@ -58,6 +61,7 @@ public:
 public:
     PackageConfig &operator[](const Package &p);
     const PackageConfig &operator[](const Package &p) const;
+    const PackageConfig &operator[](PackageId id) const;
 
     iterator begin();
     iterator end();
@@ -65,20 +69,21 @@ public:
     const_iterator begin() const;
     const_iterator end() const;
 
-    iterator find(const PackageConfigs::key_type &k) { return packages.find(k); }
-    const_iterator find(const PackageConfigs::key_type &k) const { return packages.find(k); }
+    iterator find(const Package &p) { return packages.find(getPackageId(p)); }
+    const_iterator find(const Package &p) const { return packages.find(getPackageId(p)); }
 
     bool empty() const { return packages.empty(); }
     size_t size() const { return packages.size(); }
 
 public:
-    std::unordered_set<Package> known_local_packages;
+    std::unordered_set<PackageId> known_local_packages;
 
 private:
     PackageConfigs packages;
-    std::set<std::unique_ptr<Config>> config_store;
+    // all configs of the run, deque keeps addresses stable
+    std::deque<Config> config_store;
 
-    std::unordered_map<Package, Package> resolved_packages;
+    PackagesMap resolved_packages;
     std::unordered_map<ProjectPath, path> local_packages;
 
     bool processing = false;
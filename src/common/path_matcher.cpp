@@ -0,0 +1,185 @@
+/*
+ * Copyright (C) 2016-2017, Egor Pugin
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "path_matcher.h"
+
+#include <cctype>
+
+namespace
+{
+
+bool starts_with(const String &s, const String &prefix)
+{
+    return s.size() >= prefix.size() && s.compare(0, prefix.size(), prefix) == 0;
+}
+
+bool ends_with(const String &s, const String &suffix)
+{
+    return s.size() >= suffix.size() && s.compare(s.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+bool is_regex_symbol(char c)
+{
+    switch (c)
+    {
+    case '^': case '$': case '\\': case '.': case '|':
+    case '*': case '+': case '?':
+    case '(': case ')': case '[': case ']': case '{': case '}':
+        return true;
+    }
+    return false;
+}
+
+bool is_quantifier(char c)
+{
+    return c == '*' || c == '+' || c == '?' || c == '{';
+}
+
+// reads literal part of the regex starting from pos,
+// pos is set to the first non literal symbol
+String read_literal(const String &s, size_t &pos)
+{
+    String r;
+    while (pos < s.size())
+    {
+        auto c = s[pos];
+        size_t len = 1;
+        if (c == '\\')
+        {
+            // only escaped punctuation is literal, '\d', '\w' etc. are classes
+            if (pos + 1 == s.size() || std::isalnum((unsigned char)s[pos + 1]))
+                break;
+            c = s[pos + 1];
+            len = 2;
+        }
+        else if (is_regex_symbol(c))
+            break;
+
+        // quantified symbol is not a part of the literal
+        if (pos + len < s.size() && is_quantifier(s[pos + len]))
+            break;
+
+        r += c;
+        pos += len;
+    }
+    return r;
+}
+
+// 'a/b/c' -> 'a/b/', 'a' -> ''
+String dir_of(const String &s)
+{
+    auto p = s.rfind('/');
+    if (p == s.npos)
+        return String();
+    return s.substr(0, p + 1);
+}
+
+}
+
+bool PathMatcher::Wildcard::match(const String &p) const
+{
+    if (p.size() < prefix.size() + suffix.size() || !starts_with(p, prefix) || !ends_with(p, suffix))
+        return false;
+    if (any)
+        return true;
+    return p.find('/', prefix.size()) >= p.size() - suffix.size();
+}
+
+PathMatcher::PathMatcher(const std::set<String> &patterns)
+{
+    String combined;
+    for (auto &e : patterns)
+    {
+        size_t pos = 0;
+        auto prefix = read_literal(e, pos);
+        if (pos == e.size())
+        {
+            literals.insert(prefix);
+            exact_dirs.push_back(dir_of(prefix));
+            continue;
+        }
+
+        auto try_wildcard = [this, &e, &prefix, pos](const String &w, bool any)
+        {
+            if (e.compare(pos, w.size(), w) != 0)
+                return false;
+            auto p = pos + w.size();
+            auto suffix = read_literal(e, p);
+            if (p != e.size() || (!any && suffix.find('/') != suffix.npos))
+                return false;
+            wildcards.push_back({ prefix, suffix, any });
+            if (any)
+                prefixes.push_back(prefix);
+            else
+                exact_dirs.push_back(dir_of(prefix));
+            return true;
+        };
+        if (try_wildcard(".*", true) || try_wildcard("[^/]*", false))
+            continue;
+
+        // top level alternation makes literal prefix meaningless
+        prefixes.push_back(e.find('|') == e.npos ? prefix : String());
+        if (!combined.empty())
+            combined += "|";
+        combined += "(?:" + e + ")";
+    }
+    if (!combined.empty())
+        regex = std::make_unique<std::regex>(combined, std::regex::optimize);
+}
+
+bool PathMatcher::empty() const
+{
+    return literals.empty() && wildcards.empty() && !regex;
+}
+
+bool PathMatcher::match(const String &p) const
+{
+    if (literals.find(p) != literals.end())
+        return true;
+    for (auto &w : wildcards)
+    {
+        if (w.match(p))
+            return true;
+    }
+    return regex && std::regex_match(p, *regex);
+}
+
+bool PathMatcher::match_below(const String &d) const
+{
+    auto dir = d + "/";
+    for (auto &p : prefixes)
+    {
+        if (starts_with(dir, p) || starts_with(p, dir))
+            return true;
+    }
+    for (auto &p : exact_dirs)
+    {
+        if (starts_with(p, dir))
+            return true;
+    }
+    return false;
+}
+
+bool PathMatcher::match_all_below(const String &d) const
+{
+    auto dir = d + "/";
+    for (auto &w : wildcards)
+    {
+        if (w.any && w.suffix.empty() && starts_with(dir, w.prefix))
+            return true;
+    }
+    return false;
+}
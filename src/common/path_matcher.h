@@ -0,0 +1,70 @@
+/*
+ * Copyright (C) 2016-2017, Egor Pugin
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "cppan_string.h"
+
+#include <memory>
+#include <regex>
+#include <set>
+#include <unordered_set>
+#include <vector>
+
+// Matches paths relative to some root dir (with '/' separators)
+// against a set of regex patterns (like 'files' or 'exclude_from_package').
+//
+// Common pattern forms are matched without regex:
+//  - literals:               'include/a.h'
+//  - prefix + any + suffix:  'src/.*', 'src/.*\.cpp'
+//  - prefix + name + suffix: '[^/]*\.h', 'include/[^/]*'
+// All other patterns are combined into a single regex.
+class PathMatcher
+{
+public:
+    PathMatcher() = default;
+    PathMatcher(const std::set<String> &patterns);
+
+    bool empty() const;
+
+    // match relative file path
+    bool match(const String &p) const;
+
+    // false when no path below relative dir 'd' can match, so it can be skipped
+    bool match_below(const String &d) const;
+
+    // true when all paths below relative dir 'd' match
+    bool match_all_below(const String &d) const;
+
+private:
+    struct Wildcard
+    {
+        String prefix;
+        String suffix;
+        bool any; // '.*' or '[^/]*'
+
+        bool match(const String &p) const;
+    };
+
+    std::unordered_set<String> literals;
+    std::vector<Wildcard> wildcards;
+    std::unique_ptr<std::regex> regex;
+
+    // dirs where matches can be found: dir + '/' must be a prefix of (or start with) them
+    std::vector<String> prefixes;
+    // same, but matches are located only in the dir itself (not below)
+    std::vector<String> exact_dirs;
+};
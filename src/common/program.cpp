@@ -82,6 +82,15 @@ path get_program()
 #endif
 }
 
+int get_current_process_id()
+{
+#ifdef _WIN32
+    return (int)GetCurrentProcessId();
+#else
+    return (int)getpid();
+#endif
+}
+
 String get_cmake_version()
 {
     static const auto err = "Cannot get cmake version. Do you have cmake added to PATH?";
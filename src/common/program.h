@@ -20,6 +20,7 @@
 #include "filesystem.h"
 
 path get_program();
+int get_current_process_id();
 String get_program_version();
 String get_program_version_string(const String &prog_name);
 
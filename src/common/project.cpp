@@ -16,11 +16,17 @@
 
 #include "project.h"
 
+#include "aho_corasick.h"
 #include "bazel/bazel.h"
 #include "checks_detail.h"
 #include "config.h"
+#include "cppan_archive.h"
+#include "directories.h"
+#include "hash.h"
 #include "http.h"
+#include "path_matcher.h"
 #include "resolver.h"
+#include "scheduler.h"
 
 #include "printers/printer.h"
 
@@ -33,6 +39,8 @@
 #include <primitives/pack.h>
 #include <primitives/patch.h>
 
+#include <fstream>
+#include <mutex>
 #include <regex>
 
 #include <primitives/log.h>
@@ -401,18 +409,107 @@ void Patch::patchSources(const Project &prj, const Files &files) const
 
     if (replace.empty() && regex_replace.empty())
         return;
+
+    // patch set hash
+    String h = "1"; // stamps format
+    for (auto &[from, to] : replace)
+        h += "\n" + from + "\n" + to;
+    h += "\n";
+    for (auto &[from, to] : regex_replace)
+        h += "\n" + from + "\n" + to;
+    h = sha256_short(h);
+
+    // stamps of already patched files: path -> (size, mtime)
+    using Stamp = std::pair<uintmax_t, fs::file_time_type::rep>;
+    std::unordered_map<String, Stamp> stamps, new_stamps;
+    auto get_stamp = [](const path &f)
+    {
+        error_code ec;
+        Stamp st{ fs::file_size(f, ec), fs::last_write_time(f, ec).time_since_epoch().count() };
+        if (ec)
+            return Stamp{};
+        return st;
+    };
+    path stamps_fn = directories.storage_dir_etc / STAMPS_DIR / "patches" / sha256_short(normalize_path(rd) + prj.pkg.target_name);
+    {
+        std::ifstream ifile(stamps_fn);
+        String line;
+        if (std::getline(ifile, line) && line == h)
+        {
+            uintmax_t size;
+            fs::file_time_type::rep mtime;
+            while (ifile >> size >> mtime && ifile.get() && std::getline(ifile, line))
+                stamps[line] = { size, mtime };
+        }
+    }
+
+    std::vector<const path *> to_patch;
+    for (auto &f : files)
+    {
+        auto fn = normalize_path(f);
+        auto st = get_stamp(f);
+        auto i = stamps.find(fn);
+        if (i != stamps.end() && i->second == st)
+            new_stamps[fn] = st;
+        else
+            to_patch.push_back(&f);
+    }
+    if (to_patch.empty() && new_stamps.size() == stamps.size())
+        return;
+
+    // literal replacements are applied one after another (later pairs see results of earlier ones),
+    // so automaton finds first pair that is present in file, earlier pairs are no-op
+    Strings patterns;
+    for (auto &p : replace)
+        patterns.push_back(p.first);
+    AhoCorasick ac(patterns);
+
     std::vector<std::pair<std::regex, String>> regex_prepared;
     for (auto &p : regex_replace)
         regex_prepared.emplace_back(std::regex(p.first), p.second);
-    for (auto &f : files)
+
+    std::mutex m;
+    auto patch_file = [this, &ac, &regex_prepared, &get_stamp, &new_stamps, &m](const path &f)
     {
         auto s = read_file(f);
-        for (auto &p : replace)
-            boost::algorithm::replace_all(s, p.first, p.second);
+        auto first = ac.find_first(s);
+        if (first != -1)
+        {
+            for (auto i = replace.begin() + first; i != replace.end(); ++i)
+                boost::algorithm::replace_all(s, i->first, i->second);
+        }
         for (auto &p : regex_prepared)
             s = std::regex_replace(s, p.first, p.second);
         write_file_if_different(f, s);
+
+        auto st = get_stamp(f);
+        std::unique_lock<std::mutex> lk(m);
+        new_stamps[normalize_path(f)] = st;
+    };
+
+    // do not start threads for a couple of files
+    if (to_patch.size() < 32)
+    {
+        for (auto f : to_patch)
+            patch_file(*f);
     }
+    else
+    {
+        parallel_for(to_patch.size(), [&patch_file, &to_patch](size_t i) { patch_file(*to_patch[i]); }, Scheduler::Io);
+    }
+
+    String st = h + "\n";
+    for (auto &[fn, s] : new_stamps)
+        st += std::to_string(s.first) + " " + std::to_string(s.second) + " " + fn + "\n";
+    fs::create_directories(stamps_fn.parent_path());
+
+    // other processes may read it at the same time
+    auto tmp = path(stamps_fn) += "." + unique_path().string();
+    write_file(tmp, st);
+    error_code ec;
+    fs::rename(tmp, stamps_fn, ec);
+    if (ec)
+        fs::remove(tmp, ec);
 }
 
 Project::Project()
@@ -425,6 +522,214 @@ Project::Project(const ProjectPath &root_project)
 {
 }
 
+// Cached result of the source scan of local project.
+// Only matched files are stored, so the cache is valid for the same patterns only.
+// On the next run only dirs with changed mtime are re-read.
+struct SourceScan
+{
+    struct Dir
+    {
+        fs::file_time_type mtime = fs::file_time_type::min();
+        Strings files;
+        Strings dirs;
+    };
+
+    // relative path -> dir, root is ""
+    std::unordered_map<String, Dir> dirs;
+    String hash;
+
+    static String join(const String &dir, const String &name)
+    {
+        return dir.empty() ? name : dir + "/" + name;
+    }
+
+    static fs::file_time_type get_mtime(const path &dir)
+    {
+        error_code ec;
+        auto t = fs::last_write_time(dir, ec);
+        if (ec)
+            return fs::file_time_type::min();
+        // mtime of recently changed dir is not reliable (fs timestamp resolution),
+        // such dir will be re-read next time
+        if (t > fs::file_time_type::clock::now() - std::chrono::seconds(2))
+            return fs::file_time_type::min();
+        return t;
+    }
+
+    // corrupted data is dropped, this leads to a full scan
+    void load(const path &fn)
+    {
+        try
+        {
+            if (load1(fn))
+                return;
+        }
+        catch (std::exception &)
+        {
+        }
+        dirs.clear();
+        hash.clear();
+    }
+
+    bool load1(const path &fn)
+    {
+        std::ifstream ifile(fn);
+        if (!ifile || !std::getline(ifile, hash))
+            return false;
+        Dir *d = nullptr;
+        String line;
+        while (std::getline(ifile, line))
+        {
+            if (line.size() < 2 || line[1] != ' ')
+                return false;
+            auto v = line.substr(2);
+            switch (line[0])
+            {
+            case 'D':
+            {
+                auto p = v.find(' ');
+                if (p == v.npos)
+                    return false;
+                d = &dirs[v.substr(p + 1)];
+                d->mtime = fs::file_time_type(fs::file_time_type::duration(std::stoll(v.substr(0, p))));
+                break;
+            }
+            case 'F':
+                if (d)
+                    d->files.push_back(v);
+                break;
+            case 'S':
+                if (d)
+                    d->dirs.push_back(v);
+                break;
+            default:
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void save(const path &fn) const
+    {
+        String s = hash + "\n";
+        for (auto &[name, d] : dirs)
+        {
+            s += "D " + std::to_string(d.mtime.time_since_epoch().count()) + " " + name + "\n";
+            for (auto &f : d.files)
+                s += "F " + f + "\n";
+            for (auto &f : d.dirs)
+                s += "S " + f + "\n";
+        }
+
+        // other processes may read it at the same time
+        auto tmp = path(fn) += "." + unique_path().string();
+        write_file(tmp, s);
+        error_code ec;
+        fs::rename(tmp, fn, ec);
+        if (ec)
+            fs::remove(tmp, ec);
+    }
+
+    // full scan, in parallel
+    // dir mtimes are needed only when the scan is saved
+    void scan(const path &root, const PathMatcher &include, const PathMatcher &exclude, bool mtimes = true)
+    {
+        auto root_s = normalize_path(root);
+        if (!root_s.empty() && root_s.back() != '/')
+            root_s += "/";
+        auto relative = [&root_s](const path &f)
+        {
+            auto s = normalize_path(f);
+            if (s.compare(0, root_s.size(), root_s) == 0)
+                s = s.substr(root_s.size());
+            return s;
+        };
+        auto split = [](const String &s)
+        {
+            auto p = s.rfind('/');
+            if (p == s.npos)
+                return std::make_pair(String(), s);
+            return std::make_pair(s.substr(0, p), s.substr(p + 1));
+        };
+
+        dirs.clear();
+        auto &r = dirs[""];
+        if (mtimes)
+            r.mtime = get_mtime(root);
+
+        std::mutex m;
+        walk_directory(root, [this, &include, &relative, &split, &m](const auto &e)
+        {
+            auto s = relative(e.path());
+            if (!e.is_regular_file() || !include.match(s))
+                return;
+            auto [dir, name] = split(s);
+            std::unique_lock<std::mutex> lk(m);
+            dirs[dir].files.push_back(name);
+        }, [this, &include, &exclude, &relative, &split, &m, mtimes](const auto &e)
+        {
+            // skip dirs that cannot contain matches
+            auto s = relative(e.path());
+            if (!include.match_below(s) || exclude.match_all_below(s))
+                return false;
+            auto mtime = mtimes ? get_mtime(e.path()) : fs::file_time_type::min();
+            auto [dir, name] = split(s);
+            std::unique_lock<std::mutex> lk(m);
+            dirs[dir].dirs.push_back(name);
+            dirs[s].mtime = mtime;
+            return true;
+        });
+    }
+
+    // re-read changed dirs only
+    void update(const path &root, const PathMatcher &include, const PathMatcher &exclude)
+    {
+        decltype(dirs) old;
+        old.swap(dirs);
+
+        std::function<void(const String &)> update_dir;
+        update_dir = [this, &root, &include, &exclude, &old, &update_dir](const String &rel)
+        {
+            auto dir = rel.empty() ? root : root / rel;
+            auto mtime = get_mtime(dir);
+            auto &d = dirs[rel];
+            auto i = old.find(rel);
+            if (mtime != fs::file_time_type::min() && i != old.end() && i->second.mtime == mtime)
+                d = std::move(i->second);
+            else
+            {
+                d.mtime = mtime;
+                error_code ec;
+                for (auto &e : fs::directory_iterator(dir, ec))
+                {
+                    auto name = e.path().filename().string();
+                    auto s = join(rel, name);
+                    if (!e.is_symlink() && e.is_directory())
+                    {
+                        if (include.match_below(s) && !exclude.match_all_below(s))
+                            d.dirs.push_back(name);
+                    }
+                    else if (e.is_regular_file() && include.match(s))
+                        d.files.push_back(name);
+                }
+            }
+            auto subdirs = d.dirs; // 'd' is invalidated by rehashing
+            for (auto &sd : subdirs)
+                update_dir(join(rel, sd));
+        };
+        update_dir("");
+    }
+
+    void get_files(const path &root, Files &files) const
+    {
+        for (auto &[rel, d] : dirs)
+        {
+            for (auto &f : d.files)
+                files.insert((root / join(rel, f)).make_preferred());
+        }
+    }
+};
+
 void Project::findSources(path p)
 {
     // output file list (files) must contain absolute paths
@@ -490,54 +795,60 @@ void Project::findSources(path p)
     if ((sources.empty() && files.empty()) && !empty)
         throw std::runtime_error("'files' must be populated");
 
-    auto create_regex = [&p](const auto &e)
+    // patterns are matched against paths relative to the root dir
+    auto root = normalize_path(p);
+    if (!root.empty() && root.back() != '/')
+        root += "/";
+    auto relative = [&root](const path &f)
     {
-        auto s = normalize_path(p);
-        s = escape_regex_symbols(s);
-        if (!s.empty() && s.back() != '/')
-            s += "/";
-        return std::regex(s + e);
+        auto s = normalize_path(f);
+        if (s.compare(0, root.size(), root) == 0)
+            s = s.substr(root.size());
+        return s;
     };
 
-    std::unordered_map<String, std::regex> rgxs, rgxs_exclude;
-
-    for (auto &e : sources)
-        rgxs[e] = create_regex(e);
-    if (!rgxs.empty())
+    PathMatcher include(sources);
+    PathMatcher exclude(exclude_from_package);
+    if (!include.empty())
     {
-        for (auto &f : fs::recursive_directory_iterator(p))
+        SourceScan scan;
+        if (pkg.flags[pfLocalProject])
         {
-            if (!fs::is_regular_file(f))
-                continue;
-
-            auto s = normalize_path(f);
-            for (auto &e : rgxs)
-            {
-                if (!std::regex_match(s, e.second))
-                    continue;
-                files.insert(f);
-                break;
-            }
+            // local projects are rescanned on every run, use cache
+            path fn = directories.storage_dir_etc / STAMPS_DIR / "sources" / sha256_short(root + pkg.ppath.toString());
+            fs::create_directories(fn.parent_path());
+
+            // key of the file name is included, the name is a short hash
+            String h = "2\n" + root + pkg.ppath.toString(); // cache format
+            for (auto &s : sources)
+                h += "\n" + s;
+            h += "\n";
+            for (auto &s : exclude_from_package)
+                h += "\n" + s;
+            h = sha256_short(h);
+
+            scan.load(fn);
+            if (scan.hash == h && scan.dirs.find("") != scan.dirs.end())
+                scan.update(p, include, exclude);
+            else
+                scan.scan(p, include, exclude);
+            scan.hash = h;
+            scan.save(fn);
         }
+        else
+            scan.scan(p, include, exclude, false);
+        scan.get_files(p, files);
     }
 
-    for (auto &e : exclude_from_package)
-        rgxs_exclude[e] = create_regex(e);
-    if (!rgxs_exclude.empty())
+    if (!exclude.empty())
     {
-        auto to_remove = files;
-        for (auto &f : files)
+        for (auto i = files.begin(); i != files.end();)
         {
-            auto s = normalize_path(f);
-            for (auto &e : rgxs_exclude)
-            {
-                if (!std::regex_match(s, e.second))
-                    continue;
-                to_remove.erase(f);
-                break;
-            }
+            if (exclude.match(relative(*i)))
+                i = files.erase(i);
+            else
+                ++i;
         }
-        files = to_remove;
     }
 
     if (files.empty() && !empty)
@@ -625,7 +936,7 @@ bool Project::writeArchive(const path &fn) const
     // some files have not abolute paths (e.g., license files)
     // do not remove until fixed
     ScopedCurrentPath cp(root_directory);
-    return pack_files(fn, files, cp.get_cwd());
+    return write_archive(fn, files, cp.get_cwd());
 }
 
 void Project::save_dependencies(yaml &node) const
@@ -872,10 +1183,10 @@ void Project::load(const yaml &root)
                     pkg.ppath = p;
                     if (!d["version"].IsDefined())
                         throw std::runtime_error("dependency: local is present, but version is not: " + p);
-                    if (rd.known_local_packages.find(pkg) != rd.known_local_packages.end())
+                    if (rd.known_local_packages.find(getPackageId(pkg)) != rd.known_local_packages.end())
                         local_ok = true;
                     pkg.version = d["version"].template as<String>();
-                    if (rd.known_local_packages.find(pkg) != rd.known_local_packages.end())
+                    if (rd.known_local_packages.find(getPackageId(pkg)) != rd.known_local_packages.end())
                         local_ok = true;
                     if (local_ok)
                         dependency.ppath = p;
@@ -188,6 +188,7 @@ struct Patch
     void patchSources(const Project &p, const Files &files) const;
 };
 
+// new fields must be added to ConfigCache (config_cache.cpp) too
 struct Project
 {
     // public data
@@ -322,6 +323,8 @@ public:
     std::shared_ptr<Project> original_project;
 
 private:
+    friend struct ConfigCache;
+
     ProjectPath root_project;
 
     const Files &getSources() const;
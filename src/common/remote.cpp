@@ -39,13 +39,14 @@ Remotes get_default_remotes()
     return rms;
 }
 
-bool Remote::downloadPackage(const Package &d, const String &hash, const path &fn, bool try_only_first) const
+bool Remote::downloadPackage(const Package &d, const String &hash, const path &fn, bool try_only_first,
+    ArchiveFormat format) const
 {
-    auto download_from_source = [&](const auto &s)
+    auto download_from_source = [&](const String &url)
     {
         try
         {
-            download_file(s(*this, d), fn);
+            download_file(url, fn);
         }
         catch (const std::exception&)
         {
@@ -54,39 +55,51 @@ bool Remote::downloadPackage(const Package &d, const String &hash, const path &f
         return check_file_hash(fn, hash);
     };
 
+    // sources that do not provide this format are skipped
     for (auto &s : primary_sources)
     {
-        if (download_from_source(s))
+        auto url = s(*this, d, format);
+        if (url.empty())
+            continue;
+        if (download_from_source(url))
             return true;
         else if (try_only_first)
             return false;
     }
 
-    if (download_from_source(default_source))
-        return true;
-    else if (try_only_first)
-        return false;
+    auto url = default_source(*this, d, format);
+    if (!url.empty())
+    {
+        if (download_from_source(url))
+            return true;
+        else if (try_only_first)
+            return false;
+    }
 
     // no try_only_first for additional sources
     for (auto &s : additional_sources)
     {
-        if (download_from_source(s))
+        url = s(*this, d, format);
+        if (!url.empty() && download_from_source(url))
             return true;
     }
     return true;
 }
 
-String Remote::default_source_provider(const Package &d) const
+String Remote::default_source_provider(const Package &d, ArchiveFormat format) const
 {
     // TODO: change later to format strings (or simple replacement)
     // %U - url, %D - data dir etc.
     auto fs_path = ProjectPath(d.ppath).toFileSystemPath().string();
     normalize_string(fs_path);
-    String package_url = url + "/" + data_dir + "/" + fs_path + "/" + make_archive_name(d.version.toString());
+    String package_url = url + "/" + data_dir + "/" + fs_path + "/" + make_archive_name(d.version.toString(), format);
     return package_url;
 }
 
-String Remote::github_source_provider(const Package &d) const
+String Remote::github_source_provider(const Package &d, ArchiveFormat format) const
 {
+    // only tar.gz archives are mirrored
+    if (format != ArchiveFormat::TarGz)
+        return {};
     return "https://github.com/cppan-packages/" + d.getHash() + "/raw/master/" + make_archive_name();
 }
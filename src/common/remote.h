@@ -16,6 +16,7 @@
 
 #pragma once
 
+#include "cppan_archive.h"
 #include "cppan_string.h"
 #include "filesystem.h"
 #include "http.h"
@@ -32,7 +33,8 @@ struct Remote
 {
     using Url = String;
     using SourcesUrls = std::vector<Url>;
-    using SourceUrlProvider = std::function<String(const Remote &, const Package &)>;
+    // returns empty url when archive format is not available
+    using SourceUrlProvider = std::function<String(const Remote &, const Package &, ArchiveFormat)>;
 
     String name;
 
@@ -48,11 +50,12 @@ struct Remote
     SourceUrlProvider default_source{ &Remote::default_source_provider };
     std::vector<SourceUrlProvider> additional_sources;
 
-    bool downloadPackage(const Package &d, const String &hash, const path &fn, bool try_only_first = false) const;
+    bool downloadPackage(const Package &d, const String &hash, const path &fn, bool try_only_first = false,
+        ArchiveFormat format = ArchiveFormat::TarGz) const;
 
 public:
-    String default_source_provider(const Package &) const;
-    String github_source_provider(const Package &) const;
+    String default_source_provider(const Package &, ArchiveFormat format) const;
+    String github_source_provider(const Package &, ArchiveFormat format) const;
 };
 
 using Remotes = std::vector<Remote>;
@@ -18,23 +18,28 @@
 
 #include "access_table.h"
 #include "config.h"
+#include "cppan_archive.h"
 #include "database.h"
 #include "directories.h"
 #include "exceptions.h"
 #include "lock.h"
+#include "program.h"
 #include "project.h"
+#include "scheduler.h"
 #include "settings.h"
 #include "sqlite_database.h"
 #include "verifier.h"
 
 #include <boost/algorithm/string.hpp>
 
-#include <primitives/executor.h>
 #include <primitives/hash.h>
 #include <primitives/hasher.h>
 #include <primitives/pack.h>
 #include <primitives/templates.h>
 
+#include <mutex>
+#include <thread>
+
 #include <primitives/log.h>
 //DECLARE_STATIC_LOGGER(logger, "resolver");
 
@@ -43,9 +48,54 @@
 TYPED_EXCEPTION(LocalDbHashException);
 TYPED_EXCEPTION(DependencyNotResolved);
 
-Resolver::Dependencies getDependenciesFromRemote(const Packages &deps, const Remote *current_remote);
-Resolver::Dependencies getDependenciesFromDb(const Packages &deps, const Remote *current_remote);
-Resolver::Dependencies prepareIdDependencies(const IdDependencies &id_deps, const Remote *current_remote);
+// Marks package download in progress.
+// Lease is valid only while its owner holds the lock on the stamp file,
+// so if we can take the lock and the lease is still here, the owner is dead.
+struct DownloadLease
+{
+    path fn;
+
+    DownloadLease(const path &hash_file)
+        : fn(path(hash_file) += ".lease")
+    {
+    }
+
+    bool exists() const
+    {
+        return fs::exists(fn);
+    }
+
+    String read() const
+    {
+        error_code ec;
+        if (!fs::exists(fn, ec))
+            return {};
+        try
+        {
+            return boost::trim_copy(read_file(fn));
+        }
+        catch (...)
+        {
+            return {};
+        }
+    }
+
+    void acquire() const
+    {
+        auto t = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
+        write_file(fn, "pid " + std::to_string(get_current_process_id()) + ", started at " + std::to_string(t));
+    }
+
+    void release() const
+    {
+        error_code ec;
+        fs::remove(fn, ec);
+    }
+};
+
+DependencyGraph getDependenciesFromRemote(const Packages &deps, const Remote *current_remote);
+DependencyGraph getDependenciesFromDb(const Packages &deps, const Remote *current_remote, Packages &failed);
+DependencyGraph prepareIdDependencies(const IdDependencies &id_deps, const Remote *current_remote);
 
 PackagesMap resolve_dependencies(const Packages &deps)
 {
@@ -72,8 +122,7 @@ void Resolver::resolve_dependencies(const Packages &dependencies)
             continue;
 
         // remove already downloaded packages
-        auto i = rd.resolved_packages.find(d.second);
-        if (i != rd.resolved_packages.end())
+        if (rd.resolved_packages.find(getPackageId(d.second)) != rd.resolved_packages.end())
             continue;
 
         deps.insert(d);
@@ -89,17 +138,17 @@ void Resolver::resolve_dependencies(const Packages &dependencies)
     {
         for (auto &dl : download_dependencies_)
         {
-            if (!dl.second.flags[pfDirectDependency])
+            if (!dl.flags[pfDirectDependency])
                 continue;
-            if (d.second.ppath == dl.second.ppath)
+            if (d.second.ppath == dl.ppath)
             {
-                resolved_packages[d.second] = dl.second;
+                resolved_packages[getPackageId(d.second)] = dl;
                 continue;
             }
             // if this is not exact match, assign to self
             // TODO: or make resolved_packages multimap
-            if (d.second.ppath.is_root_of(dl.second.ppath))
-                resolved_packages[dl.second] = dl.second;
+            if (d.second.ppath.is_root_of(dl.ppath))
+                resolved_packages[getPackageId(dl)] = dl;
         }
     }
     // push to global
@@ -114,14 +163,8 @@ void Resolver::resolve_and_download(const Package &p, const path &fn)
 {
     resolve({ { p.ppath.toString(), p } }, [&]
     {
-        for (auto &dd : download_dependencies_)
-        {
-            if (dd.second == p)
-            {
-                download(dd.second, fn);
-                break;
-            }
-        }
+        if (auto n = download_dependencies_.find(p))
+            download(download_dependencies_[*n], fn);
     });
 }
 
@@ -135,65 +178,96 @@ void Resolver::resolve(const Packages &deps, std::function<void()> resolve_actio
     auto cr = us.remotes.begin();
     current_remote = &*cr++;
 
-    auto resolve_remote_deps = [this, &deps, &cr, &us]()
+    auto resolve_remote_deps = [this, &cr, &us](const Packages &deps)
     {
-        bool again = true;
-        while (again)
+        while (1)
         {
-            again = false;
             try
             {
                 if (us.remotes.size() > 1)
                     LOG_INFO(logger, "Trying " + current_remote->name + " remote");
-                download_dependencies_ = getDependenciesFromRemote(deps, current_remote);
+                return getDependenciesFromRemote(deps, current_remote);
             }
             catch (const std::exception &e)
             {
                 LOG_WARN(logger, e.what());
-                if (cr != us.remotes.end())
-                {
-                    current_remote = &*cr++;
-                    again = true;
-                }
-                else
+                if (cr == us.remotes.end())
                     throw DependencyNotResolved();
+                current_remote = &*cr++;
             }
         }
     };
 
-    query_local_db = !us.force_server_query;
-    // do 2 attempts: 1) local db, 2) remote db
-    int n_attempts = query_local_db ? 2 : 1;
-    while (n_attempts--)
+    // remote answer is preferred over local one
+    auto merge = [this](const DependencyGraph &remote_deps)
     {
+        for (auto &d : remote_deps)
+            local_db_packages.erase(d);
+        download_dependencies_.merge(remote_deps);
+    };
+
+    download_dependencies_.clear();
+    local_db_packages.clear();
+    bad_local_packages.clear();
+
+    // resolve from local db what we can, ask server only for the rest
+    Packages remote = deps;
+    if (!us.force_server_query)
+    {
+        remote.clear();
         try
         {
-            if (query_local_db)
-            {
-                try
-                {
-                    download_dependencies_ = getDependenciesFromDb(deps, current_remote);
-                }
-                catch (std::exception &e)
-                {
-                    LOG_ERROR(logger, "Cannot get dependencies from local database: " << e.what());
+            download_dependencies_ = getDependenciesFromDb(deps, current_remote, remote);
+            for (auto &d : download_dependencies_)
+                local_db_packages.insert(d);
+        }
+        catch (std::exception &e)
+        {
+            LOG_ERROR(logger, "Cannot get dependencies from local database: " << e.what());
+            download_dependencies_.clear();
+            remote = deps;
+        }
+    }
+    if (!remote.empty())
+        merge(resolve_remote_deps(remote));
 
-                    query_local_db = false;
-                    resolve_remote_deps();
-                }
-            }
-            else
+    if (Settings::get_local_settings().unify_dependency_versions)
+    {
+        auto n = download_dependencies_.unify_versions(deps);
+        if (n)
+        {
+            LOG_INFO(logger, "Version unification: " << n << " package build(s) saved");
+            for (auto i = local_db_packages.begin(); i != local_db_packages.end();)
             {
-                resolve_remote_deps();
+                if (!download_dependencies_.find(*i))
+                    i = local_db_packages.erase(i);
+                else
+                    i++;
             }
+        }
+    }
 
+    while (1)
+    {
+        try
+        {
             resolve_action();
         }
         catch (LocalDbHashException &)
         {
-            LOG_WARN(logger, "Local db data caused issues, trying remote one");
+            // refresh only packages with stalled local data
+            Packages bad;
+            for (auto &p : bad_local_packages)
+            {
+                local_db_packages.erase(p);
+                bad[p.ppath.toString()] = p;
+            }
+            bad_local_packages.clear();
+            if (bad.empty())
+                throw;
 
-            query_local_db = false;
+            LOG_WARN(logger, "Local db data caused issues, trying remote one for " << bad.size() << " package(s)");
+            merge(resolve_remote_deps(bad));
             continue;
         }
         break;
@@ -202,14 +276,19 @@ void Resolver::resolve(const Packages &deps, std::function<void()> resolve_actio
 
 void Resolver::download(const ExtendedPackageData &d, const path &fn)
 {
-    if (!d.remote->downloadPackage(d, d.hash, fn, query_local_db))
+    bool local = local_db_packages.find(d) != local_db_packages.end();
+    if (!d.remote->downloadPackage(d, d.hash, fn, local))
     {
         // if we get hashes from local db
         // they can be stalled within server refresh time (15 mins)
         // in this case we should do request to server
         auto err = "Hashes do not match for package: " + d.target_name;
-        if (query_local_db)
+        if (local)
+        {
+            std::unique_lock<std::mutex> lk(m_bad);
+            bad_local_packages.insert(d);
             throw LocalDbHashException(err);
+        }
         throw std::runtime_error(err);
     }
 }
@@ -219,63 +298,132 @@ void Resolver::download_and_unpack()
     if (download_dependencies_.empty())
         return;
 
-    auto download_dependency = [this](auto &dd)
+    // rd is not thread safe
+    std::mutex m_rd;
+    auto add_config = [&m_rd](const auto &d)
+    {
+        std::unique_lock<std::mutex> lk(m_rd);
+        rd.add_config(d, false);
+    };
+
+    // returns false when the package is being downloaded by other process,
+    // in this case caller should try again later
+    auto download_dependency = [this, &m_rd, &add_config](auto &d, bool deferred)
     {
-        auto &d = dd.second;
         auto version_dir = d.getDirSrc();
         auto hash_file = d.getStampFilename();
-        bool must_download = d.getStampHash() != d.hash || d.hash.empty();
+        auto is_installed = [&d, &version_dir]
+        {
+            return fs::exists(version_dir) && !d.hash.empty() && d.getStampHash() == d.hash;
+        };
 
-        if (fs::exists(version_dir) && !must_download)
-            return;
+        if (is_installed())
+        {
+            // package was installed by other process while we were waiting
+            if (deferred)
+                add_config(d);
+            return true;
+        }
 
         // lock, so only one cppan process at the time could download the project
+        // lock is released by os if owner crashes
         ScopedFileLock lck(hash_file, std::defer_lock);
         if (!lck.try_lock())
         {
-            // download is in progress, wait and register config
-            ScopedFileLock lck2(hash_file);
-            rd.add_config(d, false);
-            return;
+            // download is in progress, do not wait here, process other packages
+            if (!deferred)
+            {
+                auto owner = DownloadLease(hash_file).read();
+                LOG_INFO(logger, "Deferring  : " << d.target_name << ", it is being downloaded by other process" <<
+                    (owner.empty() ? "" : " (" + owner + ")"));
+            }
+            return false;
+        }
+
+        DownloadLease lease(hash_file);
+        if (lease.exists())
+        {
+            // we hold the lock, so the owner is dead
+            LOG_WARN(logger, "Recovering stale download of " << d.target_name << " (" << lease.read() << ")");
+        }
+
+        // check again under the lock,
+        // other process could finish the package after our first check
+        if (is_installed())
+        {
+            add_config(d);
+            return true;
         }
 
+        lease.acquire();
+        SCOPE_EXIT
+        {
+            lease.release();
+        };
+
         // Do this before we clean previous package version!
         // This is useful when we have network issues during download,
         // so we won't lost existing package.
         LOG_INFO(logger, "Downloading: " << d.target_name << "...");
 
         // maybe d.target_name instead of version_dir.string()?
-        path fn = make_archive_name((temp_directory_path("dl") / d.target_name).string());
-        download(d, fn);
-
-        // verify before cleaning old pkg
-        if (Settings::get_local_settings().verify_all)
-            verify(d, fn);
+        auto base = (temp_directory_path("dl") / d.target_name).string();
+        auto format = d.archive_hash.empty() ? ArchiveFormat::TarGz : d.archive_format;
+        Files files;
+        while (1)
+        {
+            // negotiated format is tried first,
+            // tar.gz is used when it cannot be downloaded or unpacked
+            path fn = make_archive_name(base, format);
+            if (format == ArchiveFormat::TarGz)
+                download(d, fn);
+            else if (!d.remote->downloadPackage(d, d.archive_hash, fn, true, format))
+            {
+                LOG_DEBUG(logger, "Cannot download " << fn.filename().string() << ", trying " <<
+                    get_archive_format_name(ArchiveFormat::TarGz));
+                fs::remove(fn);
+                format = ArchiveFormat::TarGz;
+                continue;
+            }
 
-        // remove existing version dir
-        cleanPackages(d.target_name);
+            // verify before cleaning old pkg
+            if (Settings::get_local_settings().verify_all)
+                verify(d, fn);
 
-        rd.downloads++;
-        write_file(hash_file, d.hash);
+            // remove existing version dir
+            cleanPackages(d.target_name);
 
-        LOG_INFO(logger, "Unpacking  : " << d.target_name << "...");
-        Files files;
-        try
-        {
-            files = unpack_file(fn, version_dir);
-        }
-        catch (std::exception &e)
-        {
-            LOG_ERROR(logger, e.what());
-            fs::remove(fn);
-            fs::remove_all(version_dir);
-            throw;
+            LOG_INFO(logger, "Unpacking  : " << d.target_name << "...");
+            try
+            {
+                files = read_archive(fn, version_dir);
+                fs::remove(fn);
+                break;
+            }
+            catch (std::exception &e)
+            {
+                fs::remove(fn);
+                fs::remove_all(version_dir);
+                if (format == ArchiveFormat::TarGz)
+                {
+                    LOG_ERROR(logger, e.what());
+                    throw;
+                }
+                LOG_DEBUG(logger, "Cannot unpack " << fn.filename().string() << ": " << e.what() << ", trying " <<
+                    get_archive_format_name(ArchiveFormat::TarGz));
+                format = ArchiveFormat::TarGz;
+            }
         }
-        fs::remove(fn);
+
+        rd.downloads++;
 
         // re-read in any case
         // no need to remove old config, let it die with program
-        auto c = rd.add_config(d, false);
+        Config *c;
+        {
+            std::unique_lock<std::mutex> lk(m_rd);
+            c = rd.add_config(d, false);
+        }
 
         // move all files under unpack dir
         auto ud = c->getDefaultProject(d.ppath).unpack_directory;
@@ -285,47 +433,71 @@ void Resolver::download_and_unpack()
             if (fs::exists(ud))
                 throw std::runtime_error("Cannot create unpack_directory '" + ud.string() + "' because fs object with the same name alreasy exists");
             fs::create_directories(ud);
-            for (auto &f : boost::make_iterator_range(fs::directory_iterator(version_dir), {}))
+            // collect first, do not rename while iterating
+            std::vector<path> entries;
+            for (auto &f : fs::directory_iterator(version_dir))
             {
                 if (f == ud || f.path().filename() == CPPAN_FILENAME)
                     continue;
-                if (fs::is_directory(f))
-                {
-                    copy_dir(f, ud / f.path().filename());
-                    fs::remove_all(f);
-                }
-                else if (fs::is_regular_file(f))
-                {
-                    fs::copy_file(f, ud / f.path().filename());
-                    fs::remove(f);
-                }
+                if (fs::is_directory(f) || fs::is_regular_file(f))
+                    entries.push_back(f);
             }
+            for (auto &f : entries)
+                move_path(f, ud / f.filename());
         }
-    };
 
-    Executor e(Settings::get_local_settings().max_download_threads, "Download thread");
-    std::vector<Future<void>> fs;
+        // write stamp only when package is complete,
+        // so waiters and next runs won't see half unpacked package
+        write_file(hash_file, d.hash);
+        return true;
+    };
 
     // threaded execution does not preserve object creation/destruction order,
     // so current path is not correctly restored
     // TODO: remove this! we must correctly run programs without this
     ScopedCurrentPath cp(CurrentPathScope::All);
 
+    // downloads are io tasks, everything else waits for them
+    auto run = [&download_dependency](const std::vector<DependencyGraph::Node *> &deps, bool deferred)
+    {
+        std::vector<char> done(deps.size());
+        TaskGroup g(Scheduler::Io, Scheduler::High, Settings::get_local_settings().max_download_threads);
+        for (size_t i = 0; i < deps.size(); i++)
+            g.push([&download_dependency, &done, dd = deps[i], i, deferred] { done[i] = download_dependency(*dd, deferred); });
+        g.wait();
+
+        std::vector<DependencyGraph::Node *> left;
+        for (size_t i = 0; i < deps.size(); i++)
+        {
+            if (!done[i])
+                left.push_back(deps[i]);
+        }
+        return left;
+    };
+
+    std::vector<DependencyGraph::Node *> deps;
     for (auto &dd : download_dependencies_)
-        fs.push_back(e.push([&download_dependency, &dd] { download_dependency(dd); }));
+        deps.push_back(&dd);
+    deps = run(deps, false);
 
-    for (auto &f : fs)
-        f.wait();
-    for (auto &f : fs)
-        f.get();
+    // poll packages downloaded by other processes
+    // (try lock is cheap, backoff up to 1 sec)
+    int sleep_ms = 50;
+    while (!deps.empty())
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(sleep_ms));
+        sleep_ms = std::min(sleep_ms * 2, 1000);
+        deps = run(deps, true);
+    }
 
-    // two following blocks use executor to do parallel queries
-    if (query_local_db)
+    // two following blocks do parallel queries, they are not urgent
+    TaskGroup g(Scheduler::Io, Scheduler::Low);
+    if (!local_db_packages.empty())
     {
         // send download list
         // remove this when cppan will be widely used
         // also because this download count can be easily abused
-        e.push([this]()
+        g.push([this]()
         {
             if (!current_remote)
                 return;
@@ -334,8 +506,11 @@ void Resolver::download_and_unpack()
             ptree children;
             for (auto &d : download_dependencies_)
             {
+                // server counts its own downloads
+                if (local_db_packages.find(d) == local_db_packages.end())
+                    continue;
                 ptree c;
-                c.put("", d.second.id);
+                c.put("", d.id);
                 children.push_back(std::make_pair("", c));
             }
             request.add_child("vids", children);
@@ -357,7 +532,7 @@ void Resolver::download_and_unpack()
     // send download action once
     RUN_ONCE
     {
-        e.push([this]
+        g.push([this]
         {
             try
             {
@@ -373,14 +548,14 @@ void Resolver::download_and_unpack()
         });
     };
 
-    e.wait();
+    g.wait();
 }
 
 void Resolver::post_download()
 {
     for (auto &cc : rd)
     {
-        if (cc.first == Package())
+        if (cc.second.package == Package())
             continue;
         prepare_config(cc);
     }
@@ -388,7 +563,7 @@ void Resolver::post_download()
 
 void Resolver::prepare_config(PackageStore::PackageConfigs::value_type &cc)
 {
-    auto &p = cc.first;
+    auto &p = cc.second.package;
     auto &c = cc.second.config;
     auto &dependencies = cc.second.dependencies;
     c->setPackage(p);
@@ -397,10 +572,18 @@ void Resolver::prepare_config(PackageStore::PackageConfigs::value_type &cc)
     if (p.flags[pfLocalProject])
         return;
 
+    auto n = download_dependencies_.find(p);
+    if (!n)
+    {
+        c->post_download();
+        return;
+    }
+    auto &node = download_dependencies_[*n];
+
     // prepare deps: extract real deps flags from configs
-    for (auto &dep : download_dependencies_[p].dependencies)
+    for (auto dep : node.dependencies)
     {
-        auto d = dep.second;
+        ExtendedPackageData d = download_dependencies_[dep];
         auto i = project.dependencies.find(d.ppath.toString());
         if (i == project.dependencies.end())
         {
@@ -409,11 +592,12 @@ void Resolver::prepare_config(PackageStore::PackageConfigs::value_type &cc)
             std::set<String> to_remove;
             for (auto &root_dep : project.dependencies)
             {
-                for (auto &child_dep : download_dependencies_[p].dependencies)
+                for (auto child : node.dependencies)
                 {
-                    if (root_dep.second.ppath.is_root_of(child_dep.second.ppath))
+                    auto &child_dep = download_dependencies_[child];
+                    if (root_dep.second.ppath.is_root_of(child_dep.ppath))
                     {
-                        to_add.insert({ child_dep.second.ppath.toString(), child_dep.second });
+                        to_add.insert({ child_dep.ppath.toString(), child_dep });
                         to_remove.insert(root_dep.second.ppath.toString());
                     }
                 }
@@ -441,7 +625,7 @@ void Resolver::read_configs()
         return;
     LOG_INFO(logger, "Reading package specs... ");
     for (auto &d : download_dependencies_)
-        read_config(d.second);
+        read_config(d);
 }
 
 void Resolver::read_config(const ExtendedPackageData &d)
@@ -452,7 +636,7 @@ void Resolver::read_config(const ExtendedPackageData &d)
         return;
     }
 
-    if (rd.packages.find(d) != rd.packages.end())
+    if (rd.find(d) != rd.end())
     {
         LOG_DEBUG(logger, "Package does not exist: " << d.target_name);
         return;
@@ -473,8 +657,8 @@ void Resolver::read_config(const ExtendedPackageData &d)
 
     try
     {
-        auto p = rd.config_store.insert(std::make_unique<Config>(d.getDirSrc(), false));
-        /*auto ptr = */rd.packages[d].config = p.first->get();
+        auto &c = rd.config_store.emplace_back(d.getDirSrc(), false);
+        /*auto ptr = */rd[d].config = &c;
         //ptr->created = created;
     }
     catch (DependencyNotResolved &)
@@ -494,13 +678,13 @@ void Resolver::read_config(const ExtendedPackageData &d)
 
 void Resolver::assign_dependencies(const Package &pkg, const Packages &deps)
 {
-    rd.packages[pkg].dependencies.insert(deps.begin(), deps.end());
+    rd[pkg].dependencies.insert(deps.begin(), deps.end());
     for (auto &dd : download_dependencies_)
     {
-        if (!dd.second.flags[pfDirectDependency])
+        if (!dd.flags[pfDirectDependency])
             continue;
-        auto &deps2 = rd.packages[pkg].dependencies;
-        auto i = deps2.find(dd.second.ppath.toString());
+        auto &deps2 = rd[pkg].dependencies;
+        auto i = deps2.find(dd.ppath.toString());
         if (i == deps2.end())
         {
             // check if we chose a root project match all subprojects
@@ -510,9 +694,9 @@ void Resolver::assign_dependencies(const Package &pkg, const Packages &deps)
             {
                 for (auto &child_dep : download_dependencies_)
                 {
-                    if (root_dep.second.ppath.is_root_of(child_dep.second.ppath))
+                    if (root_dep.second.ppath.is_root_of(child_dep.ppath))
                     {
-                        to_add.insert({ child_dep.second.ppath.toString(), child_dep.second });
+                        to_add.insert({ child_dep.ppath.toString(), child_dep });
                         to_remove.insert(root_dep.second.ppath.toString());
                     }
                 }
@@ -526,13 +710,13 @@ void Resolver::assign_dependencies(const Package &pkg, const Packages &deps)
             continue;
         }
         auto &d = i->second;
-        d.version = dd.second.version;
-        d.flags |= dd.second.flags;
+        d.version = dd.version;
+        d.flags |= dd.flags;
         d.createNames();
     }
 }
 
-Resolver::Dependencies getDependenciesFromRemote(const Packages &deps, const Remote *current_remote)
+DependencyGraph getDependenciesFromRemote(const Packages &deps, const Remote *current_remote)
 {
     // prepare request
     ptree request;
@@ -544,6 +728,13 @@ Resolver::Dependencies getDependenciesFromRemote(const Packages &deps, const Rem
         request.put_child(ptree::path_type(d.second.ppath.toString(), '|'), version);
     }
 
+    // content negotiation: servers may return hashes of archives in these formats
+    // (old servers ignore this)
+    String archive_formats;
+    for (auto f : get_supported_archive_formats())
+        archive_formats += get_archive_format_name(f) + ",";
+    archive_formats.resize(archive_formats.size() - 1);
+
     LOG_INFO(logger, "Requesting dependency list... ");
     {
         int ct = 5;
@@ -558,7 +749,7 @@ Resolver::Dependencies getDependenciesFromRemote(const Packages &deps, const Rem
                 req.connect_timeout = ct;
                 req.timeout = t;
                 req.type = HttpRequest::Post;
-                req.url = current_remote->url + "/api/find_dependencies";
+                req.url = current_remote->url + "/api/find_dependencies?archive_formats=" + archive_formats;
                 req.data = ptree2string(request);
                 resp = url_request(req);
                 if (resp.http_code != 200)
@@ -636,6 +827,21 @@ Resolver::Dependencies getDependenciesFromRemote(const Packages &deps, const Rem
         if (d.hash == "empty_hash")
             d.hash = v.second.get<String>("hash", "empty_hash");
 
+        // optional: archive format -> hash
+        if (auto archives = v.second.get_child_optional("archives"))
+        {
+            for (auto f : get_supported_archive_formats())
+            {
+                auto h = archives->get<String>(ptree::path_type(get_archive_format_name(f), '|'), "");
+                if (!h.empty())
+                {
+                    d.archive_format = f;
+                    d.archive_hash = h;
+                    break;
+                }
+            }
+        }
+
         if (v.second.find(DEPENDENCIES_NODE) != v.second.not_found())
         {
             std::unordered_set<ProjectVersionId> idx;
@@ -679,25 +885,27 @@ Resolver::Dependencies getDependenciesFromRemote(const Packages &deps, const Rem
     return prepareIdDependencies(id_deps, current_remote);
 }
 
-Resolver::Dependencies getDependenciesFromDb(const Packages &deps, const Remote *current_remote)
+DependencyGraph getDependenciesFromDb(const Packages &deps, const Remote *current_remote, Packages &failed)
 {
     auto &db = getPackagesDatabase();
-    auto id_deps = db.findDependencies(deps);
-    return prepareIdDependencies(id_deps, current_remote);
+    auto g = db.findDependencies(deps, &failed);
+    for (auto &d : g)
+    {
+        d.createNames();
+        d.remote = current_remote;
+    }
+    return g;
 }
 
-Resolver::Dependencies prepareIdDependencies(const IdDependencies &id_deps, const Remote *current_remote)
+DependencyGraph prepareIdDependencies(const IdDependencies &id_deps, const Remote *current_remote)
 {
-    Resolver::Dependencies dependencies;
-    for (auto &v : id_deps)
+    DependencyGraph g(id_deps);
+    for (auto &d : g)
     {
-        auto d = v.second;
         d.createNames();
         d.remote = current_remote;
-        d.prepareDependencies(id_deps);
-        dependencies[d] = d;
     }
-    return dependencies;
+    return g;
 }
 
 std::tuple<Package, PackagesSet> resolve_dependency(const String &target_name)
@@ -20,12 +20,10 @@
 #include "package_store.h"
 
 #include <functional>
+#include <mutex>
 
 class Resolver
 {
-public:
-    using Dependencies = std::unordered_map<Package, DownloadDependency>;
-
 public:
     PackagesMap resolved_packages;
 
@@ -34,9 +32,13 @@ public:
     void assign_dependencies(const Package &p, const Packages &deps); // why such name?
 
 private:
-    Dependencies download_dependencies_;
+    DependencyGraph download_dependencies_;
     const Remote *current_remote = nullptr;
-    bool query_local_db = true;
+    // packages resolved from local db, they are downloaded without server queries
+    PackagesSet local_db_packages;
+    // local db packages with stalled hashes, they are re-resolved from server
+    PackagesSet bad_local_packages;
+    std::mutex m_bad;
 
     void read_configs();
     void download_and_unpack();
@@ -17,6 +17,7 @@
 #include "settings.h"
 
 #include "access_table.h"
+#include "binary_io.h"
 #include "config.h"
 #include "database.h"
 #include "directories.h"
@@ -33,6 +34,116 @@
 #include <primitives/log.h>
 //DECLARE_STATIC_LOGGER(logger, "settings");
 
+// bump when serialized settings or loading of settings are changed
+#define SETTINGS_SNAPSHOT_VERSION 2
+
+namespace
+{
+
+// we track all valuable ENV vars
+// to be sure that we'll load correct config
+const char *hashed_env_vars[] =
+{
+    "PATH",
+    "Path",
+    "FPATH",
+    "CPATH",
+
+    // windows, msvc
+    "VSCOMNTOOLS",
+    "VS71COMNTOOLS",
+    "VS80COMNTOOLS",
+    "VS90COMNTOOLS",
+    "VS100COMNTOOLS",
+    "VS110COMNTOOLS",
+    "VS120COMNTOOLS",
+    "VS130COMNTOOLS",
+    "VS140COMNTOOLS",
+    "VS141COMNTOOLS", // 2017?
+    "VS150COMNTOOLS",
+    "VS151COMNTOOLS",
+    "VS160COMNTOOLS", // for the future
+
+    "INCLUDE",
+    "LIB",
+
+    // gcc
+    "COMPILER_PATH",
+    "LIBRARY_PATH",
+    "C_INCLUDE_PATH",
+    "CPLUS_INCLUDE_PATH",
+    "OBJC_INCLUDE_PATH",
+    //"LD_LIBRARY_PATH", // do we need these?
+    //"DYLD_LIBRARY_PATH",
+
+    "CC",
+    "CFLAGS",
+    "CXXFLAGS",
+    "CPPFLAGS",
+};
+
+// default dirs depend on them
+const char *dirs_env_vars[] =
+{
+    "HOME",
+    "USERPROFILE",
+    "TMPDIR",
+    "TMP",
+    "TEMP",
+};
+
+// calls f for every hashed value in order
+template <class F>
+void for_each_hashed_value(const Settings &s, F &&f)
+{
+    f(s.c_compiler);
+    f(s.cxx_compiler);
+    f(s.compiler);
+    f(s.c_compiler_flags);
+    for (int i = 0; i < Settings::CMakeConfigurationType::Max; i++)
+        f(s.c_compiler_flags_conf[i]);
+    f(s.cxx_compiler_flags);
+    for (int i = 0; i < Settings::CMakeConfigurationType::Max; i++)
+        f(s.cxx_compiler_flags_conf[i]);
+    f(s.compiler_flags);
+    for (int i = 0; i < Settings::CMakeConfigurationType::Max; i++)
+        f(s.compiler_flags_conf[i]);
+    f(s.link_flags);
+    for (int i = 0; i < Settings::CMakeConfigurationType::Max; i++)
+        f(s.link_flags_conf[i]);
+    f(s.link_libraries);
+    f(s.generator);
+    f(s.system_version);
+    f(s.toolset);
+    f(s.use_shared_libs);
+    f(s.configuration);
+    f(s.default_configuration);
+
+    f(s.crosscompilation);
+    f(s.host_c_compiler);
+    f(s.host_cxx_compiler);
+    f(s.host_compiler);
+
+    // 'env' vars are applied before running cmake, so they win
+    for (auto var : hashed_env_vars)
+    {
+        auto i = s.env.find(var);
+        if (i != s.env.end())
+        {
+            f(String(var));
+            f(i->second);
+            continue;
+        }
+        auto e = getenv(var);
+        if (!e)
+            continue;
+        f(String(var));
+        f(String(e));
+    }
+}
+
+}
+
 void BuildSettings::set_build_dirs(const String &name)
 {
     filename = name;
@@ -81,7 +192,11 @@ void Settings::load(const path &p, const SettingsType type)
 void Settings::load(const yaml &root, const SettingsType type)
 {
     load_main(root, type);
+    update_directories(type);
+}
 
+void Settings::update_directories(const SettingsType type) const
+{
     auto get_storage_dir = [this](SettingsType type)
     {
         switch (type)
@@ -156,6 +271,7 @@ void Settings::load_main(const yaml &root, const SettingsType type)
     YAML_EXTRACT_AUTO(max_download_threads);
     YAML_EXTRACT_AUTO(debug_generated_cmake_configs);
     YAML_EXTRACT_AUTO(install_local_packages);
+    YAML_EXTRACT_AUTO(unify_dependency_versions);
     YAML_EXTRACT(storage_dir, String);
     YAML_EXTRACT(build_dir, String);
     YAML_EXTRACT(cppan_dir, String);
@@ -366,98 +482,49 @@ bool Settings::is_custom_build_dir() const
     return build_dir_type == SettingsType::Local || build_dir_type == SettingsType::None;
 }
 
+String Settings::get_hash_key() const
+{
+    String k;
+    for_each_hashed_value(*this, [&k](const auto &v)
+    {
+        if constexpr (std::is_same_v<std::decay_t<decltype(v)>, bool>)
+            k += v ? '1' : '0';
+        else
+        {
+            k += std::to_string(v.size()) + ":";
+            k += v;
+        }
+    });
+    return k;
+}
+
 String Settings::get_hash() const
 {
+    auto k = get_hash_key();
+    if (!hash_value.empty() && k == hash_key)
+        return hash_value;
+
     Hasher h;
-    h |= c_compiler;
-    h |= cxx_compiler;
-    h |= compiler;
-    h |= c_compiler_flags;
-    for (int i = 0; i < CMakeConfigurationType::Max; i++)
-        h |= c_compiler_flags_conf[i];
-    h |= cxx_compiler_flags;
-    for (int i = 0; i < CMakeConfigurationType::Max; i++)
-        h |= cxx_compiler_flags_conf[i];
-    h |= compiler_flags;
-    for (int i = 0; i < CMakeConfigurationType::Max; i++)
-        h |= compiler_flags_conf[i];
-    h |= link_flags;
-    for (int i = 0; i < CMakeConfigurationType::Max; i++)
-        h |= link_flags_conf[i];
-    h |= link_libraries;
-    h |= generator;
-    h |= system_version;
-    h |= toolset;
-    h |= use_shared_libs;
-    h |= configuration;
-    h |= default_configuration;
-
-    h |= crosscompilation;
-    h |= host_c_compiler;
-    h |= host_cxx_compiler;
-    h |= host_compiler;
+    for_each_hashed_value(*this, [&h](const auto &v)
+    {
+        h |= v;
+    });
 
+    hash_key = std::move(k);
+    hash_value = h.hash;
+    return hash_value;
+}
+
+void Settings::apply_env() const
+{
     for (auto &o : env)
     {
-        //h |= o.first;
-        //h |= o.second;
-        // do we really need this here?
 #ifdef _WIN32
         _putenv_s(o.first.c_str(), o.second.c_str());
 #else
         setenv(o.first.c_str(), o.second.c_str(), 1);
 #endif
     }
-
-    // besides we track all valuable ENV vars
-    // to be sure that we'll load correct config
-    auto add_env = [&h](const char *var)
-    {
-        auto e = getenv(var);
-        if (!e)
-            return;
-        h |= String(var);
-        h |= String(e);
-    };
-
-    add_env("PATH");
-    add_env("Path");
-    add_env("FPATH");
-    add_env("CPATH");
-
-    // windows, msvc
-    add_env("VSCOMNTOOLS");
-    add_env("VS71COMNTOOLS");
-    add_env("VS80COMNTOOLS");
-    add_env("VS90COMNTOOLS");
-    add_env("VS100COMNTOOLS");
-    add_env("VS110COMNTOOLS");
-    add_env("VS120COMNTOOLS");
-    add_env("VS130COMNTOOLS");
-    add_env("VS140COMNTOOLS");
-    add_env("VS141COMNTOOLS"); // 2017?
-    add_env("VS150COMNTOOLS");
-    add_env("VS151COMNTOOLS");
-    add_env("VS160COMNTOOLS"); // for the future
-
-    add_env("INCLUDE");
-    add_env("LIB");
-
-    // gcc
-    add_env("COMPILER_PATH");
-    add_env("LIBRARY_PATH");
-    add_env("C_INCLUDE_PATH");
-    add_env("CPLUS_INCLUDE_PATH");
-    add_env("OBJC_INCLUDE_PATH");
-    //add_env("LD_LIBRARY_PATH"); // do we need these?
-    //add_env("DYLD_LIBRARY_PATH");
-
-    add_env("CC");
-    add_env("CFLAGS");
-    add_env("CXXFLAGS");
-    add_env("CPPFLAGS");
-
-    return h.hash;
 }
 
 bool Settings::checkForUpdates() const
@@ -496,6 +563,155 @@ bool Settings::checkForUpdates() const
     return true;
 }
 
+// has access to private data
+struct SettingsSnapshot
+{
+    template <class Ar>
+    static void io(Ar &ar, Settings &s)
+    {
+        io_all(ar, s.remotes, s.proxy,
+            s.storage_dir_type, s.storage_dir, s.build_dir_type, s.build_dir, s.cppan_dir, s.output_dir,
+            s.printerType, s.disable_update_checks, s.max_download_threads, s.debug_generated_cmake_configs,
+            s.install_local_packages,
+            s.c_compiler, s.cxx_compiler, s.compiler,
+            s.c_compiler_flags, s.c_compiler_flags_conf, s.cxx_compiler_flags, s.cxx_compiler_flags_conf,
+            s.compiler_flags, s.compiler_flags_conf, s.link_flags, s.link_flags_conf, s.link_libraries,
+            s.configuration, s.default_configuration, s.generator, s.system_version, s.toolset,
+            s.crosscompilation, s.host_c_compiler, s.host_cxx_compiler, s.host_compiler,
+            s.env, s.cmake_options, s.use_shared_libs, s.silent, s.var_check_jobs, s.build_warning_level,
+            s.use_cache, s.show_ide_projects, s.add_run_cppan_target, s.cmake_verbose, s.build_system_verbose,
+            s.force_server_query, s.unify_dependency_versions, s.verify_all, s.copy_all_libraries_to_output, s.copy_import_libs,
+            s.full_path_executables, s.rc_enabled, s.short_local_names, s.install_prefix,
+            s.additional_build_args, s.meta_target_suffix, s.dependencies,
+            s.hash_key, s.hash_value);
+    }
+};
+
+namespace binary_io
+{
+
+template <class Ar>
+void io(Ar &ar, Remote &r)
+{
+    io_all(ar, r.name, r.url, r.data_dir, r.user, r.token);
+}
+
+template <class Ar>
+void io(Ar &ar, ProxySettings &p)
+{
+    io_all(ar, p.host, p.user);
+}
+
+template <class Ar>
+void io(Ar &ar, Settings &s)
+{
+    SettingsSnapshot::io(ar, s);
+}
+
+}
+
+namespace
+{
+
+// settings files and env, they are checked on every run
+String get_snapshot_key(const path &user_config)
+{
+    String k = std::to_string(SETTINGS_SNAPSHOT_VERSION) + "\n" + get_program_version() + "\n";
+    for (auto &fn : { path(CONFIG_ROOT "default"), user_config })
+    {
+        k += normalize_path(fn) + "\n";
+        error_code ec;
+        auto sz = fs::file_size(fn, ec);
+        if (ec)
+            continue;
+        k += std::to_string(sz) + " " + std::to_string(fs::last_write_time(fn, ec).time_since_epoch().count()) + "\n";
+    }
+    auto add_env = [&k](const char *var)
+    {
+        if (auto e = getenv(var))
+            k += String(var) + "=" + e + "\n";
+    };
+    for (auto var : hashed_env_vars)
+        add_env(var);
+    for (auto var : dirs_env_vars)
+        add_env(var);
+    return k;
+}
+
+path get_snapshot_filename()
+{
+    return get_root_directory() / "settings.snapshot";
+}
+
+bool load_snapshot(Settings &s, const String &key)
+{
+    auto fn = get_snapshot_filename();
+    if (!fs::exists(fn))
+        return false;
+    try
+    {
+        auto data = read_file(fn);
+        binary_io::Reader r{ data.data(), data.data() + data.size() };
+        String k;
+        binary_io::io(r, k);
+        if (k != key)
+            return false;
+        Settings s2;
+        binary_io::io(r, s2);
+        if (r.p != r.end)
+            throw std::runtime_error("Bad settings snapshot");
+        s = std::move(s2);
+        return true;
+    }
+    catch (std::exception &e)
+    {
+        LOG_DEBUG(logger, "Cannot read settings snapshot " << fn.string() << ": " << e.what());
+    }
+    return false;
+}
+
+void save_snapshot(const Settings &s, const String &key)
+{
+    binary_io::Writer w;
+    binary_io::io(w, const_cast<String &>(key));
+    binary_io::io(w, const_cast<Settings &>(s));
+
+    // other processes may read it at the same time
+    auto fn = get_snapshot_filename();
+    auto tmp = path(fn) += "." + unique_path().string();
+    error_code ec;
+    try
+    {
+        write_file(tmp, w.s);
+    }
+    catch (std::exception &e)
+    {
+        LOG_DEBUG(logger, "Cannot write settings snapshot " << fn.string() << ": " << e.what());
+        fs::remove(tmp, ec);
+        return;
+    }
+    fs::rename(tmp, fn, ec);
+    if (ec)
+        fs::remove(tmp, ec);
+}
+
+}
+
+String serialize_settings(const Settings &s)
+{
+    binary_io::Writer w;
+    binary_io::io(w, const_cast<Settings &>(s));
+    return w.s;
+}
+
+void deserialize_settings(Settings &s, const String &data)
+{
+    binary_io::Reader r{ data.data(), data.data() + data.size() };
+    binary_io::io(r, s);
+    if (r.p != r.end)
+        throw std::runtime_error("Bad settings snapshot");
+}
+
 Settings &Settings::get(SettingsType type)
 {
     static Settings settings[toIndex(SettingsType::Max) + 1];
@@ -519,8 +735,6 @@ Settings &Settings::get(SettingsType type)
         {
             try
             {
-                s = get(SettingsType::System);
-
                 auto fn = get_config_filename();
                 if (!fs::exists(fn))
                 {
@@ -531,7 +745,19 @@ Settings &Settings::get(SettingsType type)
                     auto ss = get(SettingsType::System);
                     ss.save(fn);
                 }
-                s.load(fn, SettingsType::User);
+
+                // merged system and user settings are taken from the snapshot
+                // while settings files and env are the same
+                auto key = get_snapshot_key(fn);
+                if (load_snapshot(s, key))
+                    s.update_directories(SettingsType::User);
+                else
+                {
+                    s = get(SettingsType::System);
+                    s.load(fn, SettingsType::User);
+                    s.get_hash();
+                    save_snapshot(s, key);
+                }
             }
             catch (...)
             {
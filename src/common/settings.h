@@ -50,6 +50,7 @@ struct BuildSettings
     void append_config_name(String &s) const;
 };
 
+// new fields must be added to SettingsSnapshot (settings.cpp) too
 struct Settings
 {
     enum CMakeConfigurationType
@@ -129,6 +130,8 @@ struct Settings
     bool cmake_verbose = false;
     bool build_system_verbose = true;
     bool force_server_query = false;
+    // use one version of a dependency when it satisfies all dependents
+    bool unify_dependency_versions = false;
     bool verify_all = false;
     bool copy_all_libraries_to_output = false;
     bool copy_import_libs = false;
@@ -161,12 +164,23 @@ public:
     void save(const path &p) const;
 
     bool is_custom_build_dir() const;
+    // has no side effects, memoized
     String get_hash() const;
+    // sets 'env' vars in the current process
+    void apply_env() const;
     bool checkForUpdates() const;
 
 private:
+    // get_hash() memo: hashed values and their hash
+    mutable String hash_key;
+    mutable String hash_value;
+
     void load_main(const yaml &root, const SettingsType type);
     void load_build(const yaml &root);
+    void update_directories(const SettingsType type) const;
+    String get_hash_key() const;
+
+    friend struct SettingsSnapshot;
 
 public:
     static Settings &get(SettingsType type);
@@ -175,3 +189,7 @@ public:
     static Settings &get_local_settings();
     static void clear_local_settings();
 };
+
+// for tests
+String serialize_settings(const Settings &s);
+void deserialize_settings(Settings &s, const String &data);
@@ -16,18 +16,27 @@
 
 #include "sqlite_database.h"
 
-#include "lock.h"
-
 #include <boost/algorithm/string.hpp>
 #include <sqlite3.h>
 
 #include <algorithm>
+#include <chrono>
+#include <random>
+#include <thread>
 
 #include <primitives/log.h>
 //DECLARE_STATIC_LOGGER(logger, "sqlite_db");
 
 #define MAX_ERROR_SQL_LENGTH 200
 
+// connection tuning
+#define SQLITE_MMAP_SIZE (256 * 1024 * 1024)
+#define SQLITE_CACHE_SIZE_KB (16 * 1024)
+
+// retry policy on SQLITE_BUSY
+#define SQLITE_BUSY_MAX_WAIT_MS 60000
+#define SQLITE_BUSY_MAX_SLEEP_MS 128
+
 /*
 ** This function is used to load the contents of a database file on disk
 ** into the "main" database of open database connection pInMemory, or
@@ -96,18 +105,63 @@ int loadOrSaveDb(sqlite3 *pInMemory, const char *zFilename, int isSave)
     return rc;
 }
 
+/*
+** Busy handler with exponential backoff.
+**
+** Instead of a single long busy wait, we sleep 1, 2, 4 ... SQLITE_BUSY_MAX_SLEEP_MS ms
+** (plus small jitter, so several processes do not wake up at the same time)
+** until SQLITE_BUSY_MAX_WAIT_MS is spent. Returning 0 makes sqlite return SQLITE_BUSY.
+*/
+int busy_handler(void *, int n_calls)
+{
+    thread_local std::minstd_rand rng((unsigned)std::hash<std::thread::id>()(std::this_thread::get_id()));
+    thread_local int waited = 0;
+
+    if (n_calls == 0)
+        waited = 0;
+    if (waited >= SQLITE_BUSY_MAX_WAIT_MS)
+        return 0;
+
+    int ms = 1 << std::min(n_calls, 7);
+    ms = std::min(ms, SQLITE_BUSY_MAX_SLEEP_MS);
+    ms += rng() % (ms / 2 + 1);
+    std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+    waited += ms;
+    return 1;
+}
+
+void configure_connection(sqlite3 *db, bool read_only)
+{
+    sqlite3_busy_handler(db, busy_handler, nullptr);
+
+    auto pragma = [db](const String &sql)
+    {
+        sqlite3_exec(db, sql.c_str(), nullptr, nullptr, nullptr);
+    };
+
+    // WAL lets readers from other processes work while one writer is active
+    // mode is persistent, so read only connections will pick it up too
+    if (!read_only)
+    {
+        pragma("PRAGMA journal_mode = WAL;");
+        pragma("PRAGMA synchronous = NORMAL;");
+    }
+    pragma("PRAGMA mmap_size = " + std::to_string(SQLITE_MMAP_SIZE) + ";");
+    pragma("PRAGMA cache_size = -" + std::to_string(SQLITE_CACHE_SIZE_KB) + ";");
+    pragma("PRAGMA temp_store = MEMORY;");
+}
+
 sqlite3 *load_from_file(const path &fn, bool read_only)
 {
     sqlite3 *db = nullptr;
     bool ok = true;
-    int flags = 0;
-    //if (sqlite3_threadsafe())
-    flags |= SQLITE_OPEN_FULLMUTEX;
+    // connections are per thread (see getServiceDatabase()),
+    // so we do not need sqlite mutexes here
+    int flags = SQLITE_OPEN_NOMUTEX | SQLITE_OPEN_PRIVATECACHE;
     if (read_only)
         flags |= SQLITE_OPEN_READONLY;
     else
         flags |= SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE;
-    sqlite3_enable_shared_cache(1);
     ok = sqlite3_open_v2(fn.u8string().c_str(), &db, flags, nullptr) == SQLITE_OK;
     if (!ok)
     {
@@ -115,7 +169,7 @@ sqlite3 *load_from_file(const path &fn, bool read_only)
         sqlite3_close(db);
         throw std::runtime_error(error);
     }
-    sqlite3_busy_timeout(db, 60000);
+    configure_connection(db, read_only);
     return db;
 }
 
@@ -230,14 +284,7 @@ bool SqliteDatabase::execute(String sql, void *object, Sqlite3Callback callback,
 
     boost::trim(sql);
 
-    // TODO: remove later when sqlite won't be crashing
-    //static std::mutex m;
-    //std::unique_lock<std::mutex> lk(m);
-
-    // lock always for now
-    ScopedFileLock lock(get_lock(fullName), std::defer_lock);
-    if (!read_only)
-        lock.lock();
+    // no process lock here: concurrent access is handled by WAL and busy_handler()
 
     LOG_TRACE(logger, "Executing sql statement: " << sql);
     char *errmsg;
@@ -268,14 +315,7 @@ bool SqliteDatabase::execute(String sql, DatabaseCallback callback, bool nothrow
 
     boost::trim(sql);
 
-    // TODO: remove later when sqlite won't be crashing
-    //static std::mutex m;
-    //std::unique_lock<std::mutex> lk(m);
-
-    // lock always for now
-    ScopedFileLock lock(get_lock(fullName), std::defer_lock);
-    if (!read_only)
-        lock.lock();
+    // no process lock here: concurrent access is handled by WAL and busy_handler()
 
     //
     LOG_TRACE(logger, "Executing sql statement: " << sql);
@@ -17,62 +17,139 @@
 #include "verifier.h"
 
 #include "config.h"
+#include "cppan_archive.h"
+#include "hash.h"
 #include "http.h"
 #include "package.h"
 #include "property_tree.h"
 #include "resolver.h"
+#include "scheduler.h"
+#include "settings.h"
 #include "spec.h"
 
 #include <primitives/command.h>
 #include <primitives/pack.h>
 #include <primitives/templates.h>
 
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <tuple>
+
 #include <primitives/log.h>
 //DECLARE_STATIC_LOGGER(logger, "verifier");
 
-void verify(const String &target_name)
+// Manifest mode (default): files are hashed in place in both trees,
+// cppan archive is hashed without unpacking.
+// Full mode: original sources are packed and both archives are unpacked before hashing.
+
+namespace
 {
-    auto pkg = extractFromString(target_name);
-    verify(pkg);
+
+void remove_spec_file(FileManifest &m)
+{
+    // remove spec files, maybe check them too later
+    m.erase(std::remove_if(m.begin(), m.end(), [](auto &e) { return e.path == CPPAN_FILENAME; }), m.end());
 }
 
-void verify(const Package &pkg, path fn)
+FileManifest get_cppan_manifest(const Package &pkg, path fn, const path &dir, bool full)
 {
-    LOG_INFO(logger, "Verifying  : " << pkg.target_name << "...");
+    // download & prepare cppan sources
+    // we also resolve dependency here
+    bool rm = fn.empty();
+    if (fn.empty())
+    {
+        LOG_DEBUG(logger, "Resolving  : " << pkg.target_name << "...");
+        LOG_DEBUG(logger, "Downloading: " << pkg.target_name << "...");
 
-    auto dir = get_temp_filename("verifier");
-    auto dir_original_unprepared = dir / "original_unprepared";
-    auto dir_original = dir / "original";
+        fn = dir / make_archive_name();
+        resolve_and_download(pkg, fn);
+    }
+    SCOPE_EXIT
+    {
+        if (rm)
+            fs::remove(fn);
+    };
+
+    if (!full)
+        return read_archive_manifest(fn);
+
+    LOG_DEBUG(logger, "Unpacking  : " << pkg.target_name << "...");
     auto dir_cppan = dir / "cppan";
+    read_archive(fn, dir_cppan);
+    return make_manifest(dir_cppan);
+}
 
+// returns files to be hashed and their root,
+// changes current dir, so it must not be called concurrently
+std::tuple<Files, path> prepare_original(const Specification &spec, const path &dir, bool full)
+{
+    auto dir_original_unprepared = dir / "original_unprepared";
+    auto dir_original = dir / "original";
     fs::create_directories(dir_original_unprepared);
-    fs::create_directories(dir_original);
-    fs::create_directories(dir_cppan);
 
+    LOG_DEBUG(logger, "Downloading original package from source...");
+    LOG_DEBUG(logger, print_source(spec.source));
+
+    ScopedCurrentPath cp(dir_original_unprepared, CurrentPathScope::All);
+
+    auto source = spec.source;
+    applyVersionToUrl(source, spec.package.version);
+    download(source);
+    write_file(CPPAN_FILENAME, spec.cppan);
+
+    Config c(CPPAN_FILENAME);
+    auto &project = c.getDefaultProject();
+    project.findSources();
+
+    if (!full)
+        return { project.files, fs::absolute(project.root_directory) };
+
+    String archive_name = make_archive_name("original");
+    if (!project.writeArchive(fs::absolute(archive_name)))
+        throw std::runtime_error("Archive write failed");
+    read_archive(archive_name, dir_original);
+    return { enumerate_files_parallel(dir_original), dir_original };
+}
+
+bool compare_manifests(const FileManifest &cppan, const FileManifest &original)
+{
+    if (cppan == original)
+        return true;
+
+    // both are sorted by path
+    auto i1 = cppan.begin();
+    auto i2 = original.begin();
+    while (i1 != cppan.end() || i2 != original.end())
+    {
+        if (i2 == original.end() || (i1 != cppan.end() && i1->path < i2->path))
+            LOG_DEBUG(logger, "Missing in original package: " << (i1++)->path);
+        else if (i1 == cppan.end() || i2->path < i1->path)
+            LOG_DEBUG(logger, "Missing in cppan package: " << (i2++)->path);
+        else
+        {
+            if (!(*i1 == *i2))
+                LOG_DEBUG(logger, "Different file: " << i1->path);
+            i1++;
+            i2++;
+        }
+    }
+    return false;
+}
+
+void verify(const Package &pkg, path fn, bool full, std::mutex &m_cwd)
+{
+    LOG_INFO(logger, "Verifying  : " << pkg.target_name << "...");
+
+    auto dir = get_temp_filename("verifier");
+    fs::create_directories(dir);
     SCOPE_EXIT
     {
         error_code ec;
         fs::remove_all(dir, ec);
     };
 
-    // download & prepare cppan sources
-    // we also resolve dependency here
-    {
-        bool rm = fn.empty();
-        if (fn.empty())
-        {
-            LOG_DEBUG(logger, "Resolving  : " << pkg.target_name << "...");
-            LOG_DEBUG(logger, "Downloading: " << pkg.target_name << "...");
-
-            fn = dir_cppan / make_archive_name();
-            resolve_and_download(pkg, fn);
-        }
-
-        LOG_DEBUG(logger, "Unpacking  : " << pkg.target_name << "...");
-        unpack_file(fn, dir_cppan);
-        if (rm)
-            fs::remove(fn);
-    }
+    auto m_cppan = get_cppan_manifest(pkg, fn, dir, full);
 
     // only after cppan resolve step
     LOG_DEBUG(logger, "Downloading package specification...");
@@ -80,33 +157,63 @@ void verify(const Package &pkg, path fn)
     if (spec.package != pkg)
         throw std::runtime_error("Packages do not match (" + pkg.target_name + " vs. " + spec.package.target_name + ")");
 
-    // download & prepare original sources
+    Files files;
+    path root;
     {
-        LOG_DEBUG(logger, "Downloading original package from source...");
-        LOG_DEBUG(logger, print_source(spec.source));
+        std::unique_lock<std::mutex> lk(m_cwd);
+        std::tie(files, root) = prepare_original(spec, dir, full);
+    }
+    auto m_original = make_manifest(files, root);
 
-        ScopedCurrentPath cp(dir_original_unprepared, CurrentPathScope::All);
+    remove_spec_file(m_cppan);
+    remove_spec_file(m_original);
 
-        applyVersionToUrl(spec.source, spec.package.version);
-        download(spec.source);
-        write_file(CPPAN_FILENAME, spec.cppan);
+    LOG_DEBUG(logger, "Comparing packages...");
+    if (!compare_manifests(m_cppan, m_original))
+        throw std::runtime_error("Error! Packages are different: " + pkg.target_name);
+}
 
-        Config c(CPPAN_FILENAME);
-        auto &project = c.getDefaultProject();
-        project.findSources();
-        String archive_name = make_archive_name("original");
-        if (!project.writeArchive(fs::absolute(archive_name)))
-            throw std::runtime_error("Archive write failed");
+}
 
-        unpack_file(archive_name, dir_original);
-    }
-    fs::remove_all(dir_original_unprepared); // after current scope leave
+void verify(const String &target_name, bool full)
+{
+    auto pkg = extractFromString(target_name);
+    verify(pkg, path(), full);
+}
 
-    // remove spec files, maybe check them too later
-    fs::remove(dir_cppan / CPPAN_FILENAME);
-    fs::remove(dir_original / CPPAN_FILENAME);
+void verify(const Package &pkg, path fn, bool full)
+{
+    std::mutex m_cwd;
+    verify(pkg, fn, full, m_cwd);
+}
 
-    LOG_DEBUG(logger, "Comparing packages...");
-    if (!compare_dirs(dir_cppan, dir_original))
-        throw std::runtime_error("Error! Packages are different.");
+void verify(const Strings &target_names, bool full)
+{
+    if (target_names.size() == 1)
+        return verify(target_names[0], full);
+
+    // downloads and hashing of different packages are overlapped,
+    // only original sources preparation is serialized (it changes current dir)
+    std::mutex m_cwd;
+    std::atomic<size_t> failed{ 0 };
+    TaskGroup g(Scheduler::Io, Scheduler::Normal, Settings::get_local_settings().max_download_threads);
+    for (auto &t : target_names)
+    {
+        g.push([&t, full, &m_cwd, &failed]
+        {
+            try
+            {
+                verify(extractFromString(t), path(), full, m_cwd);
+            }
+            catch (std::exception &ex)
+            {
+                LOG_ERROR(logger, "Verification failed: " << t << ": " << ex.what());
+                failed++;
+            }
+        });
+    }
+    g.wait();
+
+    if (failed)
+        throw std::runtime_error("Error! " + std::to_string(failed) + " of " + std::to_string(target_names.size()) + " packages are different.");
 }
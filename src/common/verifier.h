@@ -18,5 +18,8 @@
 
 #include "package.h"
 
-void verify(const String &target_name);
-void verify(const Package &pkg, path fn = path());
+// full: also pack original sources and unpack both archives (slow)
+void verify(const String &target_name, bool full = false);
+void verify(const Package &pkg, path fn = path(), bool full = false);
+// packages are verified concurrently
+void verify(const Strings &target_names, bool full = false);
@@ -16,12 +16,61 @@
 
 #include "version.h"
 
-#include <regex>
+namespace
+{
+
+bool is_digit(char c)
+{
+    return (unsigned char)(c - '0') < 10;
+}
 
-const std::regex r_branch_name(R"(([a-zA-Z_][a-zA-Z0-9_-]*))");
-const std::regex r_version1(R"((\d+))");
-const std::regex r_version2(R"((\d+)\.(\d+))");
-const std::regex r_version3(R"((\d+)\.(\d+)\.(\d+))");
+bool is_alpha(char c)
+{
+    return (unsigned char)((c | 0x20) - 'a') < 26 || c == '_';
+}
+
+// \d+
+bool parse_number(const char *&p, const char *e, ProjectVersionNumber &n)
+{
+    if (p == e || !is_digit(*p))
+        return false;
+    int64_t v = 0;
+    for (; p != e && is_digit(*p); ++p)
+    {
+        v = v * 10 + (*p - '0');
+        if (v > INT32_MAX)
+            return false;
+    }
+    n = (ProjectVersionNumber)v;
+    return true;
+}
+
+// [a-zA-Z_][a-zA-Z0-9_-]*
+bool is_branch_name(const String &n)
+{
+    if (n.empty() || !is_alpha(n[0]))
+        return false;
+    for (auto c : n)
+    {
+        if (!is_alpha(c) && !is_digit(c) && c != '-')
+            return false;
+    }
+    return true;
+}
+
+// -1, 0, 1
+int compare(ProjectVersionNumber a, ProjectVersionNumber b)
+{
+    return (a > b) - (a < b);
+}
+
+// lexicographic, without branches
+int compare_numbers(const Version &l, const Version &r)
+{
+    return 4 * compare(l.major, r.major) + 2 * compare(l.minor, r.minor) + compare(l.patch, r.patch);
+}
+
+}
 
 Version::Version(ProjectVersionNumber ma, ProjectVersionNumber mi, ProjectVersionNumber pa)
     : major(ma), minor(mi), patch(pa)
@@ -44,28 +93,25 @@ Version::Version(const String &s)
 
     type = VersionType::Version;
 
-    std::smatch m;
-    if (std::regex_match(s, m, r_version3))
-    {
-        major = std::stoi(m[1].str());
-        minor = std::stoi(m[2].str());
-        patch = std::stoi(m[3].str());
-    }
-    else if (std::regex_match(s, m, r_version2))
-    {
-        major = std::stoi(m[1].str());
-        minor = std::stoi(m[2].str());
-    }
-    else if (std::regex_match(s, m, r_version1))
+    auto p = s.data();
+    auto e = p + s.size();
+    if (p != e && is_digit(*p))
     {
-        major = std::stoi(m[1].str());
+        // 1, 1.2, 1.2.3
+        ProjectVersionNumber *n[] = { &major, &minor, &patch };
+        for (int i = 0;; i++)
+        {
+            if (i == 3 || !parse_number(p, e, *n[i]))
+                throw std::runtime_error("Bad version");
+            if (p == e)
+                break;
+            if (*p++ != '.')
+                throw std::runtime_error("Bad version");
+        }
     }
-    else if (std::regex_match(s, m, r_branch_name))
+    else if (is_branch_name(s))
     {
-        branch = m[1].str();
-        String error;
-        if (!check_branch_name(branch, &error))
-            throw std::runtime_error(error);
+        branch = s;
         type = VersionType::Branch;
     }
     else
@@ -140,22 +186,21 @@ bool Version::isVersion() const
 
 bool Version::operator<(const Version &rhs) const
 {
-    if (isBranch() && rhs.isBranch())
-        return branch < rhs.branch;
-    if (isBranch())
-        return true;
-    if (rhs.isBranch())
-        return false;
-    return std::tie(major, minor, patch) < std::tie(rhs.major, rhs.minor, rhs.patch);
+    if (isBranch() | rhs.isBranch())
+    {
+        // branches go first
+        if (isBranch() && rhs.isBranch())
+            return branch < rhs.branch;
+        return isBranch();
+    }
+    return compare_numbers(*this, rhs) < 0;
 }
 
 bool Version::operator==(const Version &rhs) const
 {
-    if (isBranch() && rhs.isBranch())
+    if (isBranch() | rhs.isBranch())
         return branch == rhs.branch;
-    if (isBranch() || rhs.isBranch())
-        return false;
-    return std::tie(major, minor, patch) == std::tie(rhs.major, rhs.minor, rhs.patch);
+    return (major == rhs.major) & (minor == rhs.minor) & (patch == rhs.patch);
 }
 
 bool Version::operator!=(const Version &rhs) const
@@ -165,27 +210,23 @@ bool Version::operator!=(const Version &rhs) const
 
 bool Version::canBe(const Version &rhs) const
 {
-    if (*this == rhs)
-        return true;
-
-    // *.*.* canBe anything
-    if (major == -1 && minor == -1 && patch == -1)
-        return true;
-
-    // 1.*.* == 1.*.*
-    if (major == rhs.major && minor == -1 && patch == -1)
-        return true;
-
-    // 1.2.* == 1.2.*
-    if (major == rhs.major && minor == rhs.minor && patch == -1)
-        return true;
-
-    return false;
+    bool eq_major = major == rhs.major;
+    bool eq_minor = minor == rhs.minor;
+    bool any_minor = minor == -1;
+    bool any_patch = patch == -1;
+
+    return operator==(rhs) |
+        // *.*.* canBe anything
+        ((major == -1) & any_minor & any_patch) |
+        // 1.*.* == 1.*.*
+        (eq_major & any_minor & any_patch) |
+        // 1.2.* == 1.2.*
+        (eq_major & eq_minor & any_patch);
 }
 
 bool Version::check_branch_name(const String &n, String *error)
 {
-    if (!std::regex_match(n, r_branch_name))
+    if (!is_branch_name(n))
     {
         if (error)
             *error = "Branch name should be a-zA-Z0-9_- starting with letter or _";
@@ -25,13 +25,13 @@
 #include <inserts.h>
 #include <program.h>
 #include <resolver.h>
+#include <scheduler.h>
 #include <settings.h>
 
 #include <boost/algorithm/string.hpp>
 
 #include <primitives/command.h>
 #include <primitives/date_time.h>
-#include <primitives/executor.h>
 #ifdef _WIN32
 #include <primitives/win32helpers.h>
 #endif
@@ -147,6 +147,16 @@ void registerCmakePackage()
 #endif
 }
 
+bool isCmakePackageRegistered()
+{
+#ifdef _WIN32
+    return fs::exists(directories.get_static_files_dir() / cppan_cmake_config_filename);
+#else
+    auto cppan_cmake_dir = get_home_directory() / ".cmake" / "packages";
+    return fs::exists(cppan_cmake_dir / "CPPAN" / "1") && fs::exists(cppan_cmake_dir / cppan_cmake_config_filename);
+#endif
+}
+
 String cmake_debug_message(const String &s)
 {
     if (!Settings::get_local_settings().debug_generated_cmake_configs)
@@ -1384,14 +1394,7 @@ int CMakePrinter::generate(const BuildSettings &bs) const
     //c.arguments.push_back("-DCPPAN_TEST_RUN="s + (bs.test_run ? "1" : "0"));
     for (auto &o : s.cmake_options)
         c.arguments.push_back(o);
-    for (auto &o : s.env)
-    {
-#ifdef _WIN32
-        _putenv_s(o.first.c_str(), o.second.c_str());
-#else
-        setenv(o.first.c_str(), o.second.c_str(), 1);
-#endif
-    }
+    s.apply_env();
 
     c.buf_size = 256; // for frequent flushes
     auto ret = run_command(s, c);
@@ -3496,7 +3499,7 @@ void CMakePrinter::parallel_vars_check(const ParallelCheckOptions &o) const
         write_file(d / cmake_config_filename, ctx.getText());
 
         // copy cached cmake dir
-        copy_dir(o.dir / "CMakeFiles", d / "CMakeFiles");
+        copy_dir_parallel(o.dir / "CMakeFiles", d / "CMakeFiles");
         // since cmake 3.8
         write_file(d / "CMakeCache.txt", "CMAKE_PLATFORM_INFO_INITIALIZED:INTERNAL=1\n");
 
@@ -3589,19 +3592,16 @@ void CMakePrinter::parallel_vars_check(const ParallelCheckOptions &o) const
         w.read_parallel_checks_for_workers(d);
     };
 
-    Executor e(N);
-    std::vector<Future<void>> fs;
+    // workers wait for child cmake processes
+    TaskGroup g(Scheduler::Io, Scheduler::Normal, N);
 
     int i = 0;
     for (auto &w : workers)
-        fs.push_back(e.push([&work, &w, n = i++]() { work(w, n); }));
+        g.push([&work, &w, n = i++]() { work(w, n); });
 
-    auto t = get_time<std::chrono::seconds>([&fs]
+    auto t = get_time<std::chrono::seconds>([&g]
     {
-        for (auto &f : fs)
-            f.wait();
-        for (auto &f : fs)
-            f.get();
+        g.wait();
     });
 
     checks.checks.clear();
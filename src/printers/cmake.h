@@ -124,3 +124,5 @@ void add_aliases(primitives::Emitter &ctx, const Package &d, F &&f)
 }
 
 void registerCmakePackage();
+// cheap check, files only
+bool isCmakePackageRegistered();
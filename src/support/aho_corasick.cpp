@@ -0,0 +1,107 @@
+/*
+ * Copyright (C) 2016-2017, Egor Pugin
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "aho_corasick.h"
+
+#include <algorithm>
+#include <queue>
+
+AhoCorasick::AhoCorasick(const Strings &patterns)
+{
+    auto add_state = [this]()
+    {
+        states.emplace_back();
+        states.back().next.fill(-1);
+        return (int)states.size() - 1;
+    };
+
+    // trie
+    add_state();
+    for (size_t i = 0; i < patterns.size(); i++)
+    {
+        auto &p = patterns[i];
+        if (p.empty())
+            continue;
+        int s = 0;
+        for (unsigned char c : p)
+        {
+            if (states[s].next[c] == -1)
+            {
+                auto n = add_state();
+                states[s].next[c] = n;
+            }
+            s = states[s].next[c];
+        }
+        if (states[s].out == -1)
+            states[s].out = (int)i;
+        n_patterns++;
+    }
+
+    // fail links, full transition table
+    std::queue<int> q;
+    for (auto &n : states[0].next)
+    {
+        if (n == -1)
+            n = 0;
+        else
+        {
+            states[n].fail = 0;
+            q.push(n);
+        }
+    }
+    while (!q.empty())
+    {
+        auto s = q.front();
+        q.pop();
+
+        auto f = states[s].fail;
+        auto fo = states[f].out;
+        if (fo != -1 && (states[s].out == -1 || fo < states[s].out))
+            states[s].out = fo;
+
+        for (int c = 0; c < 256; c++)
+        {
+            auto n = states[s].next[c];
+            if (n == -1)
+                states[s].next[c] = states[f].next[c];
+            else
+            {
+                states[n].fail = states[f].next[c];
+                q.push(n);
+            }
+        }
+    }
+}
+
+int AhoCorasick::find_first(const String &s) const
+{
+    if (empty())
+        return -1;
+    int r = -1;
+    int st = 0;
+    for (unsigned char c : s)
+    {
+        st = states[st].next[c];
+        auto o = states[st].out;
+        if (o != -1 && (r == -1 || o < r))
+        {
+            r = o;
+            if (r == 0)
+                break;
+        }
+    }
+    return r;
+}
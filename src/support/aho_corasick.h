@@ -0,0 +1,46 @@
+/*
+ * Copyright (C) 2016-2017, Egor Pugin
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "cppan_string.h"
+
+#include <array>
+#include <vector>
+
+// Multi-pattern literal search (Aho-Corasick automaton).
+class AhoCorasick
+{
+public:
+    AhoCorasick(const Strings &patterns);
+
+    bool empty() const { return n_patterns == 0; }
+
+    // returns index of the first pattern (in patterns order) found in s or -1
+    int find_first(const String &s) const;
+
+private:
+    struct State
+    {
+        std::array<int, 256> next;
+        int fail = 0;
+        // min index of patterns ending in this state (including via fail links)
+        int out = -1;
+    };
+
+    std::vector<State> states;
+    size_t n_patterns = 0;
+};
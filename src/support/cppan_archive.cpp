@@ -0,0 +1,424 @@
+/*
+ * Copyright (C) 2016-2017, Egor Pugin
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "cppan_archive.h"
+
+#include "scheduler.h"
+
+#include <primitives/pack.h>
+#include <primitives/templates.h>
+
+#include <archive.h>
+#include <archive_entry.h>
+
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <set>
+#include <thread>
+
+// archives are packed once and downloaded many times,
+// but levels above 12 are too slow for big packages
+#define ZSTD_COMPRESSION_LEVEL "12"
+#define ARCHIVE_BLOCK_SIZE (1 << 20)
+#define ARCHIVE_WRITER_MAX_QUEUED_BYTES (64 << 20)
+// bigger entries are streamed to disk, not buffered
+#define ARCHIVE_MAX_BUFFERED_ENTRY_SIZE (1 << 20)
+
+static const std::vector<ArchiveFormat> archive_formats
+{
+    ArchiveFormat::TarZstd,
+    ArchiveFormat::TarGz,
+};
+
+// libarchive may be built without libzstd,
+// then it falls back to an external program or fails
+static bool is_zstd_supported()
+{
+    auto r = archive_read_new();
+    auto w = archive_write_new();
+    bool ok = archive_read_support_filter_zstd(r) == ARCHIVE_OK &&
+        archive_write_add_filter_zstd(w) == ARCHIVE_OK;
+    archive_write_free(w);
+    archive_read_free(r);
+    return ok;
+}
+
+const std::vector<ArchiveFormat> &get_supported_archive_formats()
+{
+    static const std::vector<ArchiveFormat> formats = []
+    {
+        std::vector<ArchiveFormat> formats;
+        for (auto f : archive_formats)
+        {
+            if (f != ArchiveFormat::TarZstd || is_zstd_supported())
+                formats.push_back(f);
+        }
+        return formats;
+    }();
+    return formats;
+}
+
+String get_archive_format_name(ArchiveFormat f)
+{
+    switch (f)
+    {
+    case ArchiveFormat::TarGz:
+        return "tar.gz";
+    case ArchiveFormat::TarZstd:
+        return "tar.zst";
+    }
+    throw std::logic_error("Unknown archive format");
+}
+
+ArchiveFormat get_archive_format(const String &name)
+{
+    for (auto f : archive_formats)
+    {
+        if (get_archive_format_name(f) == name)
+            return f;
+    }
+    throw std::runtime_error("Unknown archive format: " + name);
+}
+
+ArchiveFormat get_archive_format(const path &fn)
+{
+    auto s = fn.filename().string();
+    for (auto f : archive_formats)
+    {
+        auto ext = "." + get_archive_format_name(f);
+        if (s.size() > ext.size() && s.compare(s.size() - ext.size(), ext.size(), ext) == 0)
+            return f;
+    }
+    return ArchiveFormat::TarGz;
+}
+
+String make_archive_name(const String &fn, ArchiveFormat f)
+{
+    return (fn.empty() ? "cppan" : fn) + "." + get_archive_format_name(f);
+}
+
+static bool write_archive_zstd(const path &fn, const Files &files, const path &root)
+{
+    auto a = archive_write_new();
+    SCOPE_EXIT
+    {
+        archive_write_free(a);
+    };
+
+    if (archive_write_add_filter_zstd(a) != ARCHIVE_OK ||
+        archive_write_set_filter_option(a, "zstd", "compression-level", ZSTD_COMPRESSION_LEVEL) != ARCHIVE_OK)
+        throw std::runtime_error("Cannot create " + fn.string() + ": " + archive_error_string(a));
+    // multithreaded compression, old libarchive warns about unknown option
+    if (archive_write_set_filter_option(a, "zstd", "threads",
+        std::to_string(std::max(1u, std::thread::hardware_concurrency())).c_str()) < ARCHIVE_WARN)
+        throw std::runtime_error("Cannot create " + fn.string() + ": " + archive_error_string(a));
+    archive_write_set_format_pax_restricted(a);
+#ifdef _WIN32
+    if (archive_write_open_filename_w(a, fn.wstring().c_str()) != ARCHIVE_OK)
+#else
+    if (archive_write_open_filename(a, fn.string().c_str()) != ARCHIVE_OK)
+#endif
+        return false;
+
+    std::vector<char> buf(ARCHIVE_BLOCK_SIZE);
+    for (auto &f : files)
+    {
+        auto src = f.is_absolute() ? f : root / f;
+        auto name = f.is_absolute() ? f.lexically_relative(root) : f;
+        if (!fs::is_regular_file(src))
+            continue;
+
+        auto e = archive_entry_new();
+        SCOPE_EXIT
+        {
+            archive_entry_free(e);
+        };
+        archive_entry_set_pathname(e, normalize_path(name).c_str());
+        archive_entry_set_size(e, fs::file_size(src));
+        archive_entry_set_filetype(e, AE_IFREG);
+        archive_entry_set_perm(e, 0644);
+        if (archive_write_header(a, e) != ARCHIVE_OK)
+            return false;
+
+        std::ifstream ifile(src, std::ios::binary);
+        while (ifile)
+        {
+            ifile.read(buf.data(), buf.size());
+            if (ifile.gcount() && archive_write_data(a, buf.data(), (size_t)ifile.gcount()) < 0)
+                return false;
+        }
+    }
+    return archive_write_close(a) == ARCHIVE_OK;
+}
+
+namespace
+{
+
+// Writes unpacked files on io threads.
+// Small files unpacking is bound by syscalls (create, write, close), not by decompression.
+struct ArchiveWriter
+{
+    struct Entry
+    {
+        path fn;
+        String data;
+    };
+
+    std::atomic<size_t> queued_bytes{ 0 };
+    // last, waits for tasks on destruction
+    TaskGroup g{ Scheduler::Io };
+
+    // limits memory used by unpacked data:
+    // when writers are behind, caller writes itself (never block, we may run on an io thread too)
+    bool full() const
+    {
+        return queued_bytes >= ARCHIVE_WRITER_MAX_QUEUED_BYTES;
+    }
+
+    void push(Entry &&e)
+    {
+        queued_bytes += e.data.size();
+        g.push([this, e = std::move(e)]
+        {
+            write(e);
+            queued_bytes -= e.data.size();
+        });
+    }
+
+    // rethrows write errors
+    void finish()
+    {
+        g.wait();
+    }
+
+    static void write(const Entry &e)
+    {
+        std::ofstream ofile(e.fn, std::ios::binary | std::ios::trunc);
+        if (!ofile)
+            throw std::runtime_error("Cannot create file: " + e.fn.string());
+        ofile.write(e.data.data(), e.data.size());
+        if (!ofile)
+            throw std::runtime_error("Cannot write file: " + e.fn.string());
+    }
+};
+
+archive *open_archive(const path &fn)
+{
+    auto a = archive_read_new();
+    archive_read_support_filter_all(a);
+    archive_read_support_format_all(a);
+#ifdef _WIN32
+    if (archive_read_open_filename_w(a, fn.wstring().c_str(), ARCHIVE_BLOCK_SIZE) != ARCHIVE_OK)
+#else
+    if (archive_read_open_filename(a, fn.string().c_str(), ARCHIVE_BLOCK_SIZE) != ARCHIVE_OK)
+#endif
+    {
+        String err = archive_error_string(a);
+        archive_read_free(a);
+        throw std::runtime_error("Cannot open archive " + fn.string() + ": " + err);
+    }
+    return a;
+}
+
+// normalized, must not escape the target dir
+path get_entry_name(archive_entry *e)
+{
+    path name = archive_entry_pathname(e);
+    name = name.lexically_normal();
+    if (name.is_absolute() || name.has_root_name() || (!name.empty() && *name.begin() == ".."))
+        throw std::runtime_error("Bad archive entry: " + name.string());
+    return name;
+}
+
+// writes entry data block by block
+int write_entry_data(archive *a, const path &fn)
+{
+    std::ofstream ofile(fn, std::ios::binary | std::ios::trunc);
+    if (!ofile)
+        throw std::runtime_error("Cannot create file: " + fn.string());
+    const void *buf;
+    size_t size;
+    la_int64_t offset;
+    int r;
+    while ((r = archive_read_data_block(a, &buf, &size, &offset)) == ARCHIVE_OK)
+    {
+        // sparse files
+        if (offset != ofile.tellp())
+            ofile.seekp(offset);
+        ofile.write((const char *)buf, size);
+        if (!ofile)
+            throw std::runtime_error("Cannot write file: " + fn.string());
+    }
+    return r;
+}
+
+// decompresses on the calling thread, small files are written by ArchiveWriter
+Files extract_archive(const path &fn, const path &dir)
+{
+    auto a = open_archive(fn);
+    SCOPE_EXIT
+    {
+        archive_read_free(a);
+    };
+
+    Files files;
+    std::set<path> dirs;
+    ArchiveWriter w;
+    archive_entry *e;
+    int r;
+    while ((r = archive_read_next_header(a, &e)) == ARCHIVE_OK)
+    {
+        auto name = get_entry_name(e);
+        if (archive_entry_filetype(e) != AE_IFREG)
+            continue;
+
+        auto dst = dir / name;
+
+        // dirs are created here, so writers do not race on them
+        if (dirs.insert(dst.parent_path()).second)
+            fs::create_directories(dst.parent_path());
+
+        files.insert(dst);
+        if (!archive_entry_size_is_set(e) || archive_entry_size(e) > ARCHIVE_MAX_BUFFERED_ENTRY_SIZE || w.full())
+        {
+            if ((r = write_entry_data(a, dst)) != ARCHIVE_EOF)
+                throw std::runtime_error("Cannot unpack " + fn.string() + ": " + archive_error_string(a));
+            continue;
+        }
+
+        String data;
+        data.reserve((size_t)archive_entry_size(e));
+        const void *buf;
+        size_t size;
+        la_int64_t offset;
+        while ((r = archive_read_data_block(a, &buf, &size, &offset)) == ARCHIVE_OK)
+        {
+            // sparse files
+            if ((size_t)offset > data.size())
+                data.resize((size_t)offset);
+            data.append((const char *)buf, size);
+        }
+        if (r != ARCHIVE_EOF)
+            throw std::runtime_error("Cannot unpack " + fn.string() + ": " + archive_error_string(a));
+
+        w.push({ dst, std::move(data) });
+    }
+    if (r != ARCHIVE_EOF)
+        throw std::runtime_error("Cannot unpack " + fn.string() + ": " + archive_error_string(a));
+
+    w.finish();
+    return files;
+}
+
+}
+
+bool write_archive(const path &fn, const Files &files, const path &root)
+{
+    switch (get_archive_format(fn))
+    {
+    case ArchiveFormat::TarZstd:
+        return write_archive_zstd(fn, files, root);
+    default:
+        return pack_files(fn, files, root);
+    }
+}
+
+Files read_archive(const path &fn, const path &dir)
+{
+    // unpack to the staging dir near the target (same fs),
+    // so failed unpack does not leave partial files in target dir
+    auto stage = dir.parent_path() / (dir.filename().string() + ".unpack." + unique_path().string());
+    SCOPE_EXIT
+    {
+        error_code ec;
+        fs::remove_all(stage, ec);
+    };
+    fs::create_directories(stage);
+    auto staged = extract_archive(fn, stage);
+
+    // commit
+    error_code ec;
+    if (fs::exists(dir) && fs::is_empty(dir))
+        fs::remove(dir, ec);
+    if (!fs::exists(dir))
+        fs::rename(stage, dir);
+    else
+    {
+        // merge top level entries into existing dir
+        for (auto &e : fs::directory_iterator(stage))
+        {
+            auto dst = dir / e.path().filename();
+            if (fs::exists(dst) && fs::is_directory(dst) && fs::is_directory(e))
+            {
+                copy_dir_parallel(e.path(), dst);
+                continue;
+            }
+            fs::remove_all(dst, ec);
+            fs::rename(e.path(), dst);
+        }
+    }
+
+    Files files;
+    for (auto &f : staged)
+        files.insert(dir / f.lexically_relative(stage));
+    return files;
+}
+
+FileManifest read_archive_manifest(const path &fn)
+{
+    auto a = open_archive(fn);
+    SCOPE_EXIT
+    {
+        archive_read_free(a);
+    };
+
+    FileManifest m;
+    TreeHash h;
+    archive_entry *e;
+    int r;
+    while ((r = archive_read_next_header(a, &e)) == ARCHIVE_OK)
+    {
+        auto name = get_entry_name(e);
+        if (archive_entry_filetype(e) != AE_IFREG)
+            continue;
+
+        uintmax_t size = 0;
+        const void *buf;
+        size_t n;
+        la_int64_t offset;
+        while ((r = archive_read_data_block(a, &buf, &n, &offset)) == ARCHIVE_OK)
+        {
+            // sparse files
+            if ((uintmax_t)offset > size)
+            {
+                String zeros((size_t)(offset - size), 0);
+                h.update(zeros.data(), zeros.size());
+                size = offset;
+            }
+            h.update((const char *)buf, n);
+            size += n;
+        }
+        if (r != ARCHIVE_EOF)
+            throw std::runtime_error("Cannot read " + fn.string() + ": " + archive_error_string(a));
+        m.push_back({ normalize_path(name), size, h.final() });
+    }
+    if (r != ARCHIVE_EOF)
+        throw std::runtime_error("Cannot read " + fn.string() + ": " + archive_error_string(a));
+
+    std::sort(m.begin(), m.end());
+    return m;
+}
@@ -0,0 +1,48 @@
+/*
+ * Copyright (C) 2016-2017, Egor Pugin
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "cppan_string.h"
+#include "filesystem.h"
+#include "hash.h"
+
+#include <vector>
+
+enum class ArchiveFormat
+{
+    TarGz,
+    TarZstd,
+};
+
+// formats available at runtime, in order of preference
+const std::vector<ArchiveFormat> &get_supported_archive_formats();
+
+// 'tar.gz', 'tar.zst'
+String get_archive_format_name(ArchiveFormat f);
+ArchiveFormat get_archive_format(const String &name);
+
+String make_archive_name(const String &fn, ArchiveFormat f);
+
+// by file extension, TarGz for unknown ones
+ArchiveFormat get_archive_format(const path &fn);
+
+// format is selected by file extension
+bool write_archive(const path &fn, const Files &files, const path &root);
+Files read_archive(const path &fn, const path &dir);
+
+// hashes files without unpacking them
+FileManifest read_archive_manifest(const path &fn);
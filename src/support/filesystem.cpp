@@ -16,6 +16,35 @@
 
 #include "filesystem.h"
 
+#include "scheduler.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <limits>
+#include <mutex>
+#include <sstream>
+#include <unordered_set>
+
+#if defined(__linux__)
+#include <fcntl.h>
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#elif defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/clonefile.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#elif defined(_WIN32)
+#include <windows.h>
+#endif
+
+// more helpers do not help on a single disk
+#define MAX_WALK_HELPERS 8
+
 path get_config_filename()
 {
     return get_root_directory() / CPPAN_FILENAME;
@@ -93,3 +122,364 @@ path findRootDirectory(const path &p)
     findRootDirectory1(p, root);
     return root;
 }
+
+namespace
+{
+
+struct DirectoryWalker
+{
+    using FileHandler = std::function<void(const fs::directory_entry &)>;
+    using DirHandler = std::function<bool(const fs::directory_entry &)>;
+
+    struct Queue
+    {
+        std::mutex m;
+        std::deque<path> dirs;
+    };
+
+    const FileHandler &on_file;
+    const DirHandler &on_dir;
+    std::vector<Queue> queues;
+    // queued and being listed
+    std::atomic<size_t> pending{ 0 };
+    std::atomic<size_t> queued{ 0 };
+    std::atomic_bool stopped{ false };
+    // idle helpers sleep here
+    std::mutex m;
+    std::condition_variable cv;
+    std::atomic<size_t> waiting{ 0 };
+    std::mutex m_error;
+    std::exception_ptr error;
+
+    DirectoryWalker(size_t n_queues, const FileHandler &on_file, const DirHandler &on_dir)
+        : on_file(on_file), on_dir(on_dir), queues(n_queues)
+    {
+    }
+
+    void push(size_t w, const path &p)
+    {
+        pending++;
+        {
+            std::unique_lock<std::mutex> lk(queues[w].m);
+            queues[w].dirs.push_back(p);
+        }
+        queued++;
+        if (waiting)
+            notify(false);
+    }
+
+    void notify(bool all)
+    {
+        // lock, so a helper cannot miss the change between its check and wait
+        std::unique_lock<std::mutex> lk(m);
+        lk.unlock();
+        if (all)
+            cv.notify_all();
+        else
+            cv.notify_one();
+    }
+
+    bool pop(size_t w, path &p)
+    {
+        // own queue is lifo (depth first), steal from others in fifo order (bigger subtrees)
+        {
+            auto &q = queues[w];
+            std::unique_lock<std::mutex> lk(q.m);
+            if (!q.dirs.empty())
+            {
+                p = std::move(q.dirs.back());
+                q.dirs.pop_back();
+                queued--;
+                return true;
+            }
+        }
+        for (size_t i = 1; i < queues.size(); i++)
+        {
+            auto &q = queues[(w + i) % queues.size()];
+            std::unique_lock<std::mutex> lk(q.m);
+            if (!q.dirs.empty())
+            {
+                p = std::move(q.dirs.front());
+                q.dirs.pop_front();
+                queued--;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void process(size_t w, const path &dir)
+    {
+        for (auto &e : fs::directory_iterator(dir))
+        {
+            // types are cached by directory_entry from the listing,
+            // so only symlinks are stat'ed (by user callbacks)
+            if (!e.is_symlink() && e.is_directory())
+            {
+                if (!on_dir || on_dir(e))
+                    push(w, e.path());
+            }
+            else
+                on_file(e);
+        }
+    }
+
+    bool process_one(size_t w)
+    {
+        path p;
+        if (!pop(w, p))
+            return false;
+        try
+        {
+            process(w, p);
+        }
+        catch (...)
+        {
+            std::unique_lock<std::mutex> lk(m_error);
+            if (!error)
+                error = std::current_exception();
+            stopped = true;
+        }
+        if (--pending == 0 || stopped)
+            notify(true);
+        return true;
+    }
+
+    void run(size_t w)
+    {
+        while (!stopped && pending)
+        {
+            if (process_one(w))
+                continue;
+            std::unique_lock<std::mutex> lk(m);
+            waiting++;
+            cv.wait(lk, [this] { return stopped || !pending || queued; });
+            waiting--;
+        }
+    }
+};
+
+}
+
+void walk_directory(const path &root,
+    const std::function<void(const fs::directory_entry &)> &on_file,
+    const std::function<bool(const fs::directory_entry &)> &on_dir)
+{
+    // helpers are io tasks, so walkers running at the same time share the same threads
+    auto n = std::min<size_t>(getScheduler().numberOfThreads(Scheduler::Io), MAX_WALK_HELPERS) + 1;
+    DirectoryWalker w(n, on_file, on_dir);
+    w.push(0, root);
+
+    // list root first, do not start helpers for flat dirs
+    w.process_one(0);
+    if (w.stopped || w.pending < 2)
+    {
+        w.run(0);
+        if (w.error)
+            std::rethrow_exception(w.error);
+        return;
+    }
+
+    TaskGroup g(Scheduler::Io);
+    for (size_t i = 1; i < n; i++)
+        g.push([&w, i] { w.run(i); });
+    w.run(0);
+    g.wait();
+
+    if (w.error)
+        std::rethrow_exception(w.error);
+}
+
+Files enumerate_files_parallel(const path &dir)
+{
+    Files files;
+    std::mutex m;
+    walk_directory(dir, [&files, &m](const auto &e)
+    {
+        if (!e.is_regular_file())
+            return;
+        std::unique_lock<std::mutex> lk(m);
+        files.insert(e.path());
+    });
+    return files;
+}
+
+void copy_dir_parallel(const path &src, const path &dst)
+{
+    fs::create_directories(dst);
+    walk_directory(src, [&src, &dst](const auto &e)
+    {
+        if (e.is_regular_file())
+            fs::copy_file(e.path(), dst / e.path().lexically_relative(src), fs::copy_options::overwrite_existing);
+    }, [&src, &dst](const auto &e)
+    {
+        fs::create_directories(dst / e.path().lexically_relative(src));
+        return true;
+    });
+}
+
+static bool clone_file(const path &src, const path &dst)
+{
+#if defined(__linux__)
+    auto in = open(src.c_str(), O_RDONLY | O_CLOEXEC);
+    if (in == -1)
+        return false;
+    auto out = open(dst.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (out == -1)
+    {
+        close(in);
+        return false;
+    }
+
+    bool ok = false;
+#ifdef FICLONE
+    ok = ioctl(out, FICLONE, in) == 0;
+#endif
+    if (!ok)
+    {
+        // in-kernel copy
+        struct stat st;
+        if (fstat(in, &st) == 0)
+        {
+            off_t left = st.st_size;
+            ssize_t n = 0;
+            while (left > 0 && (n = copy_file_range(in, nullptr, out, nullptr, left, 0)) > 0)
+                left -= n;
+            ok = left == 0;
+        }
+    }
+
+    if (ok)
+    {
+        struct stat st;
+        if (fstat(in, &st) == 0)
+            fchmod(out, st.st_mode & 07777);
+    }
+    close(in);
+    close(out);
+    return ok;
+#elif defined(__APPLE__)
+    return clonefile(src.c_str(), dst.c_str(), 0) == 0;
+#else
+    return false;
+#endif
+}
+
+bool sync_file(const path &src, const path &dst)
+{
+    error_code ec;
+    auto src_mtime = fs::last_write_time(src);
+    if (fs::file_size(src) == fs::file_size(dst, ec) && !ec &&
+        src_mtime == fs::last_write_time(dst, ec) && !ec)
+        return false;
+
+    fs::create_directories(dst.parent_path());
+    fs::remove(dst, ec);
+    if (!clone_file(src, dst))
+        fs::copy_file(src, dst, fs::copy_options::overwrite_existing);
+    fs::last_write_time(dst, src_mtime);
+    return true;
+}
+
+void sync_files(const std::map<path, path> &files, const path &dst_dir, const path &list_fn)
+{
+    std::unordered_set<String> dsts;
+    String list;
+    for (auto &[src, dst] : files)
+    {
+        sync_file(src, dst);
+        auto r = normalize_path(dst.lexically_relative(dst_dir));
+        dsts.insert(r);
+        list += r + "\n";
+    }
+
+    // remove files of the previous sync only
+    error_code ec;
+    if (fs::exists(list_fn, ec))
+    {
+        std::istringstream ss(read_file(list_fn));
+        String r;
+        while (std::getline(ss, r))
+        {
+            if (r.empty() || dsts.find(r) != dsts.end())
+                continue;
+            fs::remove(dst_dir / r, ec);
+        }
+    }
+
+    fs::create_directories(list_fn.parent_path());
+    auto tmp = path(list_fn) += "." + unique_path().string();
+    write_file(tmp, list);
+    fs::rename(tmp, list_fn, ec);
+    if (ec)
+        fs::remove(tmp, ec);
+}
+
+void move_path(const path &src, const path &dst)
+{
+    error_code ec;
+    fs::rename(src, dst, ec);
+    if (!ec)
+        return;
+
+    // different devices
+    if (fs::is_directory(src))
+        copy_dir_parallel(src, dst);
+    else
+        fs::copy_file(src, dst, fs::copy_options::overwrite_existing);
+    fs::remove_all(src);
+}
+
+MappedFile::MappedFile(const path &fn)
+{
+    auto sz = fs::file_size(fn);
+    if (sz == 0)
+        return;
+    if (sz > std::numeric_limits<size_t>::max())
+        throw std::runtime_error("File is too big to be mapped: " + fn.string());
+    size = (size_t)sz;
+
+#ifdef _WIN32
+    file = CreateFileW(fn.wstring().c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE,
+        nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        file = nullptr;
+        throw std::runtime_error("Cannot open file: " + fn.string());
+    }
+    mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (mapping)
+        data = (const char *)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, size);
+    if (!data)
+    {
+        if (mapping)
+            CloseHandle(mapping);
+        CloseHandle(file);
+        throw std::runtime_error("Cannot map file: " + fn.string());
+    }
+#else
+    auto fd = open(fn.c_str(), O_RDONLY);
+    if (fd == -1)
+        throw std::runtime_error("Cannot open file: " + fn.string());
+    auto p = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED)
+        throw std::runtime_error("Cannot map file: " + fn.string());
+    data = (const char *)p;
+#endif
+}
+
+MappedFile::~MappedFile()
+{
+#ifdef _WIN32
+    if (data)
+        UnmapViewOfFile(data);
+    if (mapping)
+        CloseHandle(mapping);
+    if (file)
+        CloseHandle(file);
+#else
+    if (data)
+        munmap((void *)data, size);
+#endif
+}
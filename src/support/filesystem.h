@@ -18,6 +18,7 @@
 
 #include <primitives/filesystem.h>
 
+#include <functional>
 #include <unordered_map>
 
 #define STAMPS_DIR "stamps"
@@ -37,3 +38,52 @@ String get_stamp_filename(const String &prefix);
 String make_archive_name(const String &fn = String());
 
 path findRootDirectory(const path &p);
+
+// Walks a dir tree with several threads.
+// Entry types are taken from the directory listing, no additional stat calls.
+// 'on_dir' is called for every found dir (not followed symlinks),
+// if it returns false, dir is skipped.
+// 'on_file' is called for all other entries.
+// Both callbacks are called concurrently from walker threads.
+void walk_directory(const path &root,
+    const std::function<void(const fs::directory_entry &)> &on_file,
+    const std::function<bool(const fs::directory_entry &)> &on_dir = {});
+
+// parallel versions of enumerate_files() and copy_dir()
+Files enumerate_files_parallel(const path &dir);
+void copy_dir_parallel(const path &src, const path &dst);
+
+// Copies file when destination differs by size or mtime (mtime is copied too).
+// Copy-on-write clone is tried first, then in-kernel copy.
+// Hardlinks are not used: changes of storage copies must not go to user files.
+// Returns true if file was copied.
+bool sync_file(const path &src, const path &dst);
+
+// Syncs files (src -> dst, dst is under dst_dir).
+// Files of the previous sync (listed in 'list_fn') that are not in the list now are removed,
+// other files in dst_dir are not touched (e.g. generated ones).
+void sync_files(const std::map<path, path> &files, const path &dst_dir, const path &list_fn);
+
+// Renames, falls back to copy + remove for different devices.
+void move_path(const path &src, const path &dst);
+
+// Read-only view of the whole file (memory mapped).
+class MappedFile
+{
+public:
+    MappedFile(const path &fn);
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+    ~MappedFile();
+
+    const char *begin() const { return data; }
+    const char *end() const { return data + size; }
+
+private:
+    const char *data = nullptr;
+    size_t size = 0;
+#ifdef _WIN32
+    void *file = nullptr;
+    void *mapping = nullptr;
+#endif
+};
@@ -16,6 +16,14 @@
 
 #include "hash.h"
 
+#include "scheduler.h"
+
+#include <algorithm>
+#include <fstream>
+
+#define TREE_HASH_PREFIX "tree:"
+#define TREE_HASH_CHUNK_SIZE (1 << 20)
+
 String shorten_hash(const String &data)
 {
     return shorten_hash(data, CPPAN_CONFIG_HASH_SHORT_LENGTH);
@@ -33,5 +41,89 @@ String hash_config(const String &c)
 
 bool check_file_hash(const path &fn, const String &hash)
 {
+    if (hash.compare(0, sizeof(TREE_HASH_PREFIX) - 1, TREE_HASH_PREFIX) == 0)
+        return hash == tree_file_hash(fn);
     return hash == strong_file_hash(fn);
 }
+
+String tree_file_hash(const path &fn)
+{
+    auto size = fs::file_size(fn);
+    auto n_chunks = std::max<size_t>(1, (size_t)((size + TREE_HASH_CHUNK_SIZE - 1) / TREE_HASH_CHUNK_SIZE));
+    std::vector<String> hashes(n_chunks);
+    parallel_for(n_chunks, [&fn, &hashes, size](size_t i)
+    {
+        // one stream per chunk, chunks are big enough
+        std::ifstream ifile(fn, std::ios::binary);
+        if (!ifile)
+            throw std::runtime_error("Cannot open file: " + fn.string());
+        auto offset = (uintmax_t)i * TREE_HASH_CHUNK_SIZE;
+        auto len = (size_t)std::min<uintmax_t>(TREE_HASH_CHUNK_SIZE, size - offset);
+        String buf(len, 0);
+        ifile.seekg(offset);
+        ifile.read(&buf[0], len);
+        if ((size_t)ifile.gcount() != len)
+            throw std::runtime_error("File was changed during hashing: " + fn.string());
+        hashes[i] = sha256(buf);
+    });
+
+    auto h = std::to_string(size);
+    for (auto &c : hashes)
+        h += c;
+    return TREE_HASH_PREFIX + sha256(h);
+}
+
+void TreeHash::update(const char *data, size_t n)
+{
+    size += n;
+    while (n)
+    {
+        auto len = std::min<size_t>(n, TREE_HASH_CHUNK_SIZE - chunk.size());
+        chunk.append(data, len);
+        data += len;
+        n -= len;
+        if (chunk.size() == TREE_HASH_CHUNK_SIZE)
+        {
+            hashes += sha256(chunk);
+            chunk.clear();
+        }
+    }
+}
+
+String TreeHash::final()
+{
+    // empty file has one empty chunk
+    if (!chunk.empty() || hashes.empty())
+        hashes += sha256(chunk);
+    auto h = TREE_HASH_PREFIX + sha256(std::to_string(size) + hashes);
+    *this = TreeHash();
+    return h;
+}
+
+FileManifest make_manifest(const Files &files, const path &root)
+{
+    FileManifest m;
+    std::vector<path> src;
+    for (auto &f : files)
+    {
+        auto p = f.is_absolute() ? f : root / f;
+        if (!fs::is_regular_file(p))
+            continue;
+        m.push_back({ normalize_path((f.is_absolute() ? f.lexically_relative(root) : f).lexically_normal()), 0 });
+        src.push_back(p);
+    }
+
+    parallel_for(m.size(), [&m, &src](size_t i)
+    {
+        m[i].size = fs::file_size(src[i]);
+        m[i].hash = tree_file_hash(src[i]);
+    });
+
+    std::sort(m.begin(), m.end());
+    return m;
+}
+
+FileManifest make_manifest(const path &dir)
+{
+    return make_manifest(enumerate_files_parallel(dir), dir);
+}
@@ -16,12 +16,57 @@
 
 #pragma once
 
+#include "filesystem.h"
+
 #include <primitives/hash.h>
 
+#include <tuple>
+#include <vector>
+
 #define CPPAN_CONFIG_HASH_METHOD "SHA256"
 #define CPPAN_CONFIG_HASH_SHORT_LENGTH 8
 
 String shorten_hash(const String &data);
 String sha256_short(const String &data);
 String hash_config(const String &c);
+// accepts strong_file_hash() and tree_file_hash() formats
 bool check_file_hash(const path &fn, const String &hash);
+
+// Tree hash: file is split into chunks, chunks are hashed on several threads,
+// result is the hash of file size and chunk hashes.
+String tree_file_hash(const path &fn);
+
+// incremental tree hash for streams, gives the same result as tree_file_hash()
+class TreeHash
+{
+public:
+    void update(const char *data, size_t size);
+    String final();
+
+private:
+    String chunk;
+    String hashes;
+    uintmax_t size = 0;
+};
+
+struct FileManifestEntry
+{
+    String path; // relative, with '/' separators
+    uintmax_t size;
+    String hash; // tree hash
+
+    bool operator==(const FileManifestEntry &rhs) const
+    {
+        return std::tie(path, size, hash) == std::tie(rhs.path, rhs.size, rhs.hash);
+    }
+    bool operator<(const FileManifestEntry &rhs) const { return path < rhs.path; }
+};
+
+// sorted by path
+using FileManifest = std::vector<FileManifestEntry>;
+
+// files are hashed in place in parallel,
+// relative files are taken from root, absolute ones are named relative to root
+FileManifest make_manifest(const Files &files, const path &root);
+// all files under dir
+FileManifest make_manifest(const path &dir);
@@ -0,0 +1,322 @@
+/*
+ * Copyright (C) 2016-2017, Egor Pugin
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "scheduler.h"
+
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+struct Scheduler::Worker
+{
+    LaneData *lane;
+    std::mutex m;
+    // own tasks: lifo for the owner, fifo for thieves
+    std::deque<Task> tasks;
+    std::thread t;
+};
+
+struct Scheduler::LaneData
+{
+    std::vector<std::unique_ptr<Worker>> workers;
+    std::mutex m;
+    std::condition_variable cv;
+    std::deque<Task> queues[PriorityMax];
+    // all tasks of the lane, incremented under 'm'
+    std::atomic<size_t> queued{ 0 };
+    bool stop = false;
+};
+
+thread_local Scheduler::Worker *Scheduler::current_worker = nullptr;
+
+Scheduler::Scheduler(size_t cpu_threads, size_t io_threads)
+{
+    size_t hw = std::max(1u, std::thread::hardware_concurrency());
+    if (cpu_threads == 0)
+        cpu_threads = hw;
+    if (io_threads == 0)
+        io_threads = std::max<size_t>(8, hw * 2);
+
+    size_t n[LaneMax];
+    n[Cpu] = cpu_threads;
+    n[Io] = io_threads;
+    for (int i = 0; i < LaneMax; i++)
+    {
+        lanes[i] = std::make_unique<LaneData>();
+        auto &l = *lanes[i];
+        for (size_t j = 0; j < n[i]; j++)
+        {
+            l.workers.push_back(std::make_unique<Worker>());
+            l.workers.back()->lane = &l;
+        }
+        // start after all workers are created, they steal from each other
+        for (auto &w : l.workers)
+            w->t = std::thread([&l, w = w.get()] { run(l, *w); });
+    }
+}
+
+Scheduler::~Scheduler()
+{
+    for (auto &l : lanes)
+    {
+        {
+            std::unique_lock<std::mutex> lk(l->m);
+            l->stop = true;
+        }
+        l->cv.notify_all();
+    }
+    for (auto &l : lanes)
+    {
+        for (auto &w : l->workers)
+            w->t.join();
+    }
+}
+
+void Scheduler::push(Task &&t, Lane lane, Priority p)
+{
+    auto &l = *lanes[lane];
+    auto w = current_worker;
+    bool own = w && w->lane == &l && p != High;
+    if (own)
+    {
+        // count under the deque lock, so a thief cannot take the task before it is counted
+        {
+            std::unique_lock<std::mutex> lk(w->m);
+            w->tasks.push_back(std::move(t));
+            l.queued++;
+        }
+        // sleeping workers check the counter under l.m
+        std::unique_lock<std::mutex> lk(l.m);
+    }
+    else
+    {
+        std::unique_lock<std::mutex> lk(l.m);
+        l.queues[p].push_back(std::move(t));
+        l.queued++;
+    }
+    l.cv.notify_one();
+}
+
+bool Scheduler::pop(LaneData &l, Worker *w, Task &t)
+{
+    auto pop_queue = [&l, &t](Priority p)
+    {
+        std::unique_lock<std::mutex> lk(l.m);
+        auto &q = l.queues[p];
+        if (q.empty())
+            return false;
+        t = std::move(q.front());
+        q.pop_front();
+        l.queued--;
+        return true;
+    };
+
+    auto pop_worker = [&l, &t](Worker &w, bool own)
+    {
+        std::unique_lock<std::mutex> lk(w.m);
+        if (w.tasks.empty())
+            return false;
+        if (own)
+        {
+            t = std::move(w.tasks.back());
+            w.tasks.pop_back();
+        }
+        else
+        {
+            t = std::move(w.tasks.front());
+            w.tasks.pop_front();
+        }
+        l.queued--;
+        return true;
+    };
+
+    if (!l.queued)
+        return false;
+    if (pop_queue(High))
+        return true;
+    if (w && pop_worker(*w, true))
+        return true;
+    if (pop_queue(Normal) || pop_queue(Low))
+        return true;
+    for (auto &v : l.workers)
+    {
+        if (v.get() != w && pop_worker(*v, false))
+            return true;
+    }
+    return false;
+}
+
+void Scheduler::run(LaneData &l, Worker &w)
+{
+    current_worker = &w;
+    while (1)
+    {
+        Task t;
+        if (pop(l, &w, t))
+        {
+            t();
+            continue;
+        }
+        std::unique_lock<std::mutex> lk(l.m);
+        l.cv.wait(lk, [&l] { return l.stop || l.queued; });
+        if (l.stop && !l.queued)
+            break;
+    }
+    current_worker = nullptr;
+}
+
+size_t Scheduler::numberOfThreads(Lane lane) const
+{
+    return lanes[lane]->workers.size();
+}
+
+Scheduler &getScheduler(Scheduler *s)
+{
+    static std::atomic<Scheduler *> current{ nullptr };
+    if (s)
+    {
+        current = s;
+        return *s;
+    }
+    if (auto p = current.load())
+        return *p;
+    static Scheduler default_scheduler;
+    Scheduler *expected = nullptr;
+    current.compare_exchange_strong(expected, &default_scheduler);
+    return *current.load();
+}
+
+struct TaskGroup::State
+{
+    Scheduler &s;
+    Scheduler::Lane lane;
+    Scheduler::Priority priority;
+    size_t max_parallel;
+
+    std::mutex m;
+    std::condition_variable cv;
+    size_t unfinished = 0;
+    size_t running = 0;
+    // not started tasks, taken by scheduler runners or by the waiting thread
+    std::deque<Scheduler::Task> pending;
+    std::exception_ptr error;
+
+    State(Scheduler &s, Scheduler::Lane lane, Scheduler::Priority priority, size_t max_parallel)
+        : s(s), lane(lane), priority(priority), max_parallel(max_parallel)
+    {
+    }
+
+    bool can_start() const
+    {
+        return !pending.empty() && (!max_parallel || running < max_parallel);
+    }
+};
+
+TaskGroup::TaskGroup(Scheduler::Lane lane, Scheduler::Priority p, size_t max_parallel)
+    : state(std::make_shared<State>(getScheduler(), lane, p, max_parallel))
+{
+}
+
+TaskGroup::~TaskGroup()
+{
+    // tasks may reference caller's data
+    try
+    {
+        wait();
+    }
+    catch (...)
+    {
+    }
+}
+
+void TaskGroup::push(Scheduler::Task &&t)
+{
+    {
+        std::unique_lock<std::mutex> lk(state->m);
+        state->unfinished++;
+        state->pending.push_back(std::move(t));
+    }
+    // runner takes tasks of this group only,
+    // it does nothing if they were taken by others
+    state->s.push([st = state]
+    {
+        Scheduler::Task t;
+        while (claim(*st, t))
+            run(*st, t);
+    }, state->lane, state->priority);
+}
+
+bool TaskGroup::claim(State &st, Scheduler::Task &t)
+{
+    std::unique_lock<std::mutex> lk(st.m);
+    if (!st.can_start())
+        return false;
+    t = std::move(st.pending.front());
+    st.pending.pop_front();
+    st.running++;
+    return true;
+}
+
+void TaskGroup::run(State &st, Scheduler::Task &t)
+{
+    try
+    {
+        t();
+    }
+    catch (...)
+    {
+        std::unique_lock<std::mutex> lk(st.m);
+        if (!st.error)
+            st.error = std::current_exception();
+    }
+    t = nullptr;
+
+    {
+        std::unique_lock<std::mutex> lk(st.m);
+        st.running--;
+        st.unfinished--;
+    }
+    st.cv.notify_all();
+}
+
+void TaskGroup::wait()
+{
+    auto &st = *state;
+    while (1)
+    {
+        Scheduler::Task t;
+        if (claim(st, t))
+        {
+            run(st, t);
+            continue;
+        }
+        std::unique_lock<std::mutex> lk(st.m);
+        if (!st.unfinished)
+            break;
+        st.cv.wait(lk, [&st] { return !st.unfinished || st.can_start(); });
+    }
+
+    std::unique_lock<std::mutex> lk(st.m);
+    if (st.error)
+    {
+        auto e = st.error;
+        st.error = nullptr;
+        std::rethrow_exception(e);
+    }
+}
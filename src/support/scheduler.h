@@ -0,0 +1,146 @@
+/*
+ * Copyright (C) 2016-2017, Egor Pugin
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <memory>
+
+// Process wide thread pool.
+// There are two lanes: Cpu (hardware threads) and Io (blocking work: downloads,
+// file system, child processes), so blocking tasks do not starve cpu work.
+// Tasks pushed from a worker go to its own deque and can be stolen by idle workers,
+// other tasks are queued by priority.
+class Scheduler
+{
+public:
+    enum Lane
+    {
+        Cpu,
+        Io,
+
+        LaneMax
+    };
+
+    enum Priority
+    {
+        High,
+        Normal,
+        Low,
+
+        PriorityMax
+    };
+
+    using Task = std::function<void()>;
+
+public:
+    Scheduler(size_t cpu_threads = 0, size_t io_threads = 0);
+    Scheduler(const Scheduler &) = delete;
+    Scheduler &operator=(const Scheduler &) = delete;
+    ~Scheduler();
+
+    // tasks must not throw, use TaskGroup to get errors
+    void push(Task &&t, Lane lane = Cpu, Priority p = Normal);
+    size_t numberOfThreads(Lane lane) const;
+
+private:
+    struct Worker;
+    struct LaneData;
+
+    std::unique_ptr<LaneData> lanes[LaneMax];
+    static thread_local Worker *current_worker;
+
+    static bool pop(LaneData &l, Worker *w, Task &t);
+    static void run(LaneData &l, Worker &w);
+};
+
+// Global scheduler, created on first use.
+// main() installs its own one with getScheduler(&s).
+Scheduler &getScheduler(Scheduler *s = nullptr);
+
+// Set of tasks which are waited together.
+// wait() runs not started tasks of this group in the calling thread (never tasks
+// of other groups, the caller may hold locks), so nested groups do not deadlock.
+// wait() rethrows the first exception of tasks.
+// 'max_parallel' limits number of running tasks of the group (0 - no limit).
+class TaskGroup
+{
+public:
+    TaskGroup(Scheduler::Lane lane = Scheduler::Cpu, Scheduler::Priority p = Scheduler::Normal, size_t max_parallel = 0);
+    TaskGroup(const TaskGroup &) = delete;
+    TaskGroup &operator=(const TaskGroup &) = delete;
+    ~TaskGroup();
+
+    void push(Scheduler::Task &&t);
+    void wait();
+
+private:
+    struct State;
+    std::shared_ptr<State> state;
+
+    static bool claim(State &st, Scheduler::Task &t);
+    static void run(State &st, Scheduler::Task &t);
+};
+
+// runs f(i) for i in [0, n) on cpu workers and the calling thread
+template <class F>
+void parallel_for(size_t n, F &&f, Scheduler::Lane lane = Scheduler::Cpu)
+{
+    if (n == 0)
+        return;
+    if (n == 1)
+    {
+        f(0);
+        return;
+    }
+
+    std::atomic<size_t> next{ 0 };
+    std::atomic_bool stopped{ false };
+    auto worker = [&]()
+    {
+        size_t i;
+        while (!stopped && (i = next++) < n)
+        {
+            try
+            {
+                f(i);
+            }
+            catch (...)
+            {
+                stopped = true;
+                throw;
+            }
+        }
+    };
+
+    TaskGroup g(lane);
+    auto n_helpers = std::min(n, getScheduler().numberOfThreads(lane) + 1) - 1;
+    for (size_t i = 0; i < n_helpers; i++)
+        g.push(worker);
+    try
+    {
+        worker();
+    }
+    catch (...)
+    {
+        stopped = true;
+        g.wait();
+        throw;
+    }
+    g.wait();
+}
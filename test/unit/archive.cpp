@@ -0,0 +1,86 @@
+#include <cppan_archive.h>
+
+#include <primitives/filesystem.h>
+
+#include <random>
+
+#define CATCH_CONFIG_RUNNER
+#define CATCH_CONFIG_ENABLE_BENCHMARKING
+#include <catch2/catch.hpp>
+
+// creates n source-like files of about file_size bytes
+Files make_tree(const path &root, int n, size_t file_size)
+{
+    std::mt19937 g(0);
+    Strings words{ "int", "return", "const", "auto", "for", "if", "std::vector<int>", "(", ")", "{", "}", ";\n" };
+    Files files;
+    for (int i = 0; i < n; i++)
+    {
+        auto fn = root / ("dir" + std::to_string(i % 16)) / ("file" + std::to_string(i) + ".cpp");
+        String s;
+        while (s.size() < file_size)
+            s += words[g() % words.size()] + " ";
+        fs::create_directories(fn.parent_path());
+        write_file(fn, s);
+        files.insert(fn);
+    }
+    return files;
+}
+
+TEST_CASE("round trip", "[archive]")
+{
+    auto dir = fs::temp_directory_path() / "cppan_archive_test" / unique_path();
+    auto files = make_tree(dir / "src", 50, 1000);
+
+    for (auto f : get_supported_archive_formats())
+    {
+        INFO(get_archive_format_name(f));
+
+        auto fn = dir / make_archive_name("a", f);
+        CHECK(get_archive_format(fn) == f);
+        REQUIRE(write_archive(fn, files, dir / "src"));
+
+        auto out = dir / ("out." + get_archive_format_name(f));
+        auto unpacked = read_archive(fn, out);
+        REQUIRE(unpacked.size() == files.size());
+        for (auto &u : files)
+            CHECK(read_file(u) == read_file(out / u.lexically_relative(dir / "src")));
+
+        // hashed without unpacking
+        CHECK(read_archive_manifest(fn) == make_manifest(files, dir / "src"));
+    }
+
+    fs::remove_all(dir);
+}
+
+// run with '[benchmark]' argument
+TEST_CASE("throughput", "[.][benchmark]")
+{
+    // large package, about 40 MB
+    auto dir = fs::temp_directory_path() / "cppan_archive_test" / unique_path();
+    auto files = make_tree(dir / "src", 2000, 20000);
+
+    for (auto f : get_supported_archive_formats())
+    {
+        auto name = get_archive_format_name(f);
+        auto fn = dir / make_archive_name("a", f);
+
+        BENCHMARK("pack " + name)
+        {
+            return write_archive(fn, files, dir / "src");
+        };
+
+        BENCHMARK("unpack " + name)
+        {
+            return read_archive(fn, dir / ("out." + name)).size();
+        };
+    }
+
+    fs::remove_all(dir);
+}
+
+int main(int argc, char **argv)
+{
+    auto rc = Catch::Session().run(argc, argv);
+    return rc;
+}
@@ -0,0 +1,114 @@
+#include <checks.h>
+
+#include <algorithm>
+#include <memory>
+
+#define CATCH_CONFIG_RUNNER
+#include <catch2/catch.hpp>
+
+Checks make_checks(const String &s)
+{
+    Checks c;
+    c.load(YAML::Load(s));
+    return c;
+}
+
+TEST_CASE("merge", "[checks]")
+{
+    auto c1 = make_checks(R"(
+check_function_exists:
+    - fseeko
+    - name: memcpy
+      headers: string.h
+check_include_exists:
+    - unistd.h
+)");
+    auto c2 = make_checks(R"(
+check_function_exists:
+    - fseeko
+    - name: memcpy
+      headers: memory.h
+check_include_exists:
+    - unistd.h
+    - stdint.h
+)");
+
+    Checks c;
+    c += c1;
+    c += c2;
+    c += c1;
+    // memcpy with different headers is a different check,
+    // load() also adds size_t and void * checks
+    CHECK(c.checks.size() == 7);
+
+    for (auto &ch : c.checks)
+        CHECK(ch->getId() != 0);
+
+    // order: type, then variable
+    CHECK(std::is_sorted(c.checks.begin(), c.checks.end(), [](auto &a, auto &b)
+    {
+        return std::make_tuple(a->getInformation().type, a->getVariable()) < std::make_tuple(b->getInformation().type, b->getVariable());
+    }));
+
+    c.remove_known_vars({ "HAVE_FSEEKO", "HAVE_STDINT_H" });
+    CHECK(c.checks.size() == 5);
+    for (auto &ch : c.checks)
+        CHECK(ch->getVariable() != "HAVE_FSEEKO");
+
+    c.checks.clear();
+    CHECK(c.checks.empty());
+    c += c2;
+    CHECK(c.checks.size() == 6);
+}
+
+TEST_CASE("copy", "[checks]")
+{
+    const String s = R"(
+check_function_exists:
+    - fseeko
+check_include_exists:
+    - unistd.h
+)";
+    auto c = std::make_unique<Checks>(make_checks(s));
+    auto copy = *c;
+    c.reset();
+
+    // duplicates are found through the index of the copy
+    auto dup = make_checks(s);
+    copy += dup;
+    CHECK(copy.checks.size() == 4);
+
+    for (auto &ch : dup.checks)
+    {
+        if (ch->getVariable() == "HAVE_FSEEKO")
+        {
+            copy.checks.erase(ch);
+            break;
+        }
+    }
+    CHECK(copy.checks.size() == 3);
+    for (auto &ch : copy.checks)
+        CHECK(ch->getVariable() != "HAVE_FSEEKO");
+}
+
+TEST_CASE("parameters hash", "[checks]")
+{
+    CheckParameters p1, p2;
+    p1.headers = { "ab" };
+    p2.headers = { "a", "b" };
+    CHECK(std::hash<CheckParameters>()(p1) != std::hash<CheckParameters>()(p2));
+
+    p2.headers = { "ab" };
+    CHECK(std::hash<CheckParameters>()(p1) == std::hash<CheckParameters>()(p2));
+
+    // same values in different lists
+    p2.headers.clear();
+    p2.definitions = { "ab" };
+    CHECK(std::hash<CheckParameters>()(p1) != std::hash<CheckParameters>()(p2));
+}
+
+int main(int argc, char **argv)
+{
+    auto rc = Catch::Session().run(argc, argv);
+    return rc;
+}
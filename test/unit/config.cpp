@@ -0,0 +1,57 @@
+#include <config.h>
+#include <config_cache.h>
+
+#define CATCH_CONFIG_RUNNER
+#include <catch2/catch.hpp>
+
+String make_config(int n_projects)
+{
+    String s = "projects:\n";
+    for (int i = 0; i < n_projects; i++)
+    {
+        auto n = std::to_string(i);
+        s += "    lib" + n + ":\n";
+        s += "        type: lib\n";
+        s += "        files:\n";
+        s += "            - src" + n + "/.*\\.cpp\n";
+        s += "            - include" + n + "/.*\\.h\n";
+        s += "        include_directories:\n";
+        s += "            public: include" + n + "\n";
+        s += "        options:\n";
+        s += "            any:\n";
+        s += "                definitions:\n";
+        s += "                    public: LIB" + n + "=1\n";
+        s += "        dependencies:\n";
+        s += "            pvt.cppan.demo.dep" + n + ": 1\n";
+    }
+    return s;
+}
+
+TEST_CASE("split", "[config]")
+{
+    Config c;
+    c.load(make_config(5));
+    c.is_local = false;
+
+    auto configs = c.split();
+    REQUIRE(configs.size() == c.getProjects().size());
+    auto i = c.getProjects().begin();
+    for (auto &s : configs)
+    {
+        REQUIRE(s.getProjects().size() == 1);
+        CHECK(s.getProjects().begin()->first == i->first);
+        CHECK(!s.is_local);
+
+        // same project as in the original config
+        Config c2;
+        c2.getProjects() = { *i++ };
+        c2.is_local = false;
+        CHECK(serialize_config(s) == serialize_config(c2));
+    }
+}
+
+int main(int argc, char **argv)
+{
+    auto rc = Catch::Session().run(argc, argv);
+    return rc;
+}
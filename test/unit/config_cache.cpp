@@ -0,0 +1,67 @@
+#include <config.h>
+#include <config_cache.h>
+
+#define CATCH_CONFIG_RUNNER
+#include <catch2/catch.hpp>
+
+const String config = R"(
+source:
+    git: https://github.com/madler/zlib
+    tag: v{v}
+version: 1.2.11
+
+files:
+    - "[^/]*\\.[hc]"
+    - contrib/minizip/.*
+
+exclude_from_build:
+    - contrib/minizip/iowin32.c
+
+dependencies:
+    pvt.cppan.demo.bzip2: 1
+
+options:
+    shared:
+        definitions:
+            public: ZLIB_DLL
+
+checks:
+    function:
+        - fseeko
+    include:
+        - unistd.h
+        - stdarg.h
+
+patch:
+    replace:
+        "#ifdef HAVE_UNISTD_H": "#if HAVE_UNISTD_H"
+)";
+
+TEST_CASE("round trip", "[config_cache]")
+{
+    Config c;
+    c.load(config);
+
+    auto s = serialize_config(c);
+    Config c2;
+    deserialize_config(c2, s);
+
+    CHECK(serialize_config(c2) == s);
+    CHECK(dump_yaml_config(c2.save()) == dump_yaml_config(c.save()));
+
+    auto &p = c2.getDefaultProject();
+    CHECK(p.pkg.version == Version(1, 2, 11));
+    CHECK(p.dependencies.size() == 1);
+    CHECK(p.exclude_from_build.size() == 1);
+    CHECK(p.checks.checks.size() == c.getDefaultProject().checks.checks.size());
+    REQUIRE(p.original_project);
+    CHECK(p.original_project->sources == c.getDefaultProject().original_project->sources);
+
+    CHECK_THROWS(deserialize_config(c2, s.substr(0, s.size() / 2)));
+}
+
+int main(int argc, char **argv)
+{
+    auto rc = Catch::Session().run(argc, argv);
+    return rc;
+}
@@ -0,0 +1,97 @@
+#include <sqlite_database.h>
+
+#include <primitives/command.h>
+
+#include <atomic>
+#include <thread>
+
+#define CATCH_CONFIG_RUNNER
+#include <catch2/catch.hpp>
+
+#define N_PROCESSES 8
+#define N_INSERTS 200
+
+static path program;
+
+int child(const path &fn, int id)
+{
+    SqliteDatabase db(fn);
+    for (int i = 0; i < N_INSERTS; i++)
+    {
+        db.execute("insert into t values (" + std::to_string(id) + ", " + std::to_string(i) + ");");
+        int n = 0;
+        db.execute("select count(*) from t where process = " + std::to_string(id) + ";", [&n](SQLITE_CALLBACK_ARGS)
+        {
+            n = std::stoi(cols[0]);
+            return 0;
+        });
+        if (n != i + 1)
+            return 1;
+    }
+    return 0;
+}
+
+TEST_CASE("concurrent processes", "[sqlite]")
+{
+    auto fn = fs::temp_directory_path() / unique_path();
+    {
+        SqliteDatabase db(fn);
+        db.execute("create table t (process INTEGER NOT NULL, i INTEGER NOT NULL);");
+    }
+
+    std::vector<std::thread> threads;
+    std::atomic_int failed = 0;
+    for (int i = 0; i < N_PROCESSES; i++)
+    {
+        threads.emplace_back([i, &fn, &failed]
+        {
+            primitives::Command c;
+            c.setProgram(program);
+            c.arguments.push_back("--child");
+            c.arguments.push_back(fn.string());
+            c.arguments.push_back(std::to_string(i));
+            std::error_code ec;
+            c.execute(ec);
+            if (ec)
+                failed++;
+        });
+    }
+    for (auto &t : threads)
+        t.join();
+    CHECK(failed == 0);
+
+    {
+        SqliteDatabase db(fn);
+
+        int n = 0;
+        db.execute("select count(*) from t;", [&n](SQLITE_CALLBACK_ARGS)
+        {
+            n = std::stoi(cols[0]);
+            return 0;
+        });
+        CHECK(n == N_PROCESSES * N_INSERTS);
+
+        String mode;
+        db.execute("PRAGMA journal_mode;", [&mode](SQLITE_CALLBACK_ARGS)
+        {
+            mode = cols[0];
+            return 0;
+        });
+        CHECK(mode == "wal");
+    }
+
+    error_code ec;
+    fs::remove(fn, ec);
+    fs::remove(fn.string() + "-wal", ec);
+    fs::remove(fn.string() + "-shm", ec);
+}
+
+int main(int argc, char **argv)
+{
+    if (argc == 4 && argv[1] == std::string("--child"))
+        return child(argv[2], std::stoi(argv[3]));
+
+    program = fs::absolute(argv[0]);
+    auto rc = Catch::Session().run(argc, argv);
+    return rc;
+}
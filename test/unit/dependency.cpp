@@ -0,0 +1,178 @@
+#include <dependency.h>
+
+#define CATCH_CONFIG_RUNNER
+#include <catch2/catch.hpp>
+
+ExtendedPackageData make_package(const String &ppath, const String &version, ProjectVersionId id = 0)
+{
+    ExtendedPackageData p;
+    p.ppath = ppath;
+    p.version = version;
+    p.id = id;
+    p.createNames();
+    return p;
+}
+
+TEST_CASE("graph", "[dependency]")
+{
+    DependencyGraph g;
+    auto a = g.add(make_package("pvt.a", "1.0.0", 1));
+    auto b = g.add(make_package("pvt.b", "1.0.0", 2));
+    auto c = g.add(make_package("pvt.c", "1.0.0", 3));
+    g[a].dependencies = { b, c };
+    g[b].dependencies = { c };
+    CHECK(g.size() == 3);
+
+    // same package is stored once, data is replaced, edges are kept
+    CHECK(g.add(make_package("pvt.a", "1.0.0", 10)) == a);
+    CHECK(g.size() == 3);
+    CHECK(g[a].id == 10);
+    CHECK(g[a].dependencies.size() == 2);
+
+    CHECK(g.find(make_package("pvt.c", "1.0.0")) == c);
+    CHECK(!g.find(make_package("pvt.c", "1.0.1")));
+
+    // remote answer replaces nodes with their edges
+    DependencyGraph r;
+    auto rd = r.add(make_package("pvt.d", "1.0.0", 4));
+    auto rb = r.add(make_package("pvt.b", "1.0.0", 20));
+    r[rb].dependencies = { rd };
+    g.merge(r);
+    CHECK(g.size() == 4);
+    CHECK(g[b].id == 20);
+    REQUIRE(g[b].dependencies.size() == 1);
+    CHECK(g[g[b].dependencies[0]].ppath.toString() == "pvt.d");
+    CHECK(g[c].id == 3);
+}
+
+TEST_CASE("from ids", "[dependency]")
+{
+    IdDependencies id_deps;
+    auto add = [&id_deps](ProjectVersionId id, const String &ppath, std::unordered_set<ProjectVersionId> deps)
+    {
+        DownloadDependency d;
+        static_cast<ExtendedPackageData &>(d) = make_package(ppath, "1.0.0", id);
+        d.setDependencyIds(deps);
+        id_deps[id] = d;
+    };
+    add(1, "pvt.a", { 2, 3 });
+    add(2, "pvt.b", { 3 });
+    add(3, "pvt.c", { 3 });
+
+    DependencyGraph g(id_deps);
+    auto node = [&g](const String &ppath) { return *g.find(make_package(ppath, "1.0.0")); };
+
+    // shared dependency is stored once
+    CHECK(g.size() == 3);
+    CHECK(g[node("pvt.a")].dependencies.size() == 2);
+    CHECK(g[node("pvt.b")].dependencies == std::vector<DependencyGraph::NodeId>{ node("pvt.c") });
+    // self dependency is skipped
+    CHECK(g[node("pvt.c")].dependencies.empty());
+
+    add(4, "pvt.d", { 5 });
+    CHECK_THROWS(DependencyGraph(id_deps));
+}
+
+TEST_CASE("rollback", "[dependency]")
+{
+    DependencyGraph g;
+    auto a = g.add(make_package("pvt.a", "1.0.0", 1));
+    auto b = g.add(make_package("pvt.b", "1.0.0", 2));
+    g[a].dependencies = { b };
+
+    g.checkpoint();
+    CHECK(g.add(make_package("pvt.a", "1.0.0", 10)) == a);
+    auto c = g.add(make_package("pvt.c", "1.0.0", 3));
+    g[a].dependencies = { b, c };
+    g.rollback();
+    CHECK(g.size() == 2);
+    CHECK(!g.find(make_package("pvt.c", "1.0.0")));
+    CHECK(g[a].id == 1);
+    CHECK(g[a].dependencies == std::vector<DependencyGraph::NodeId>{ b });
+
+    // committed changes stay
+    g.checkpoint();
+    g.add(make_package("pvt.c", "1.0.0", 3));
+    g.commit();
+    g.rollback();
+    CHECK(g.size() == 3);
+    CHECK(g.find(make_package("pvt.c", "1.0.0")));
+}
+
+TEST_CASE("unify versions", "[dependency]")
+{
+    using Ids = std::vector<DependencyGraph::NodeId>;
+
+    // app -> a -> foo 1.2 (1.2.3), app -> b -> foo 1 (1.2.4), foo 1.2.3 -> bar
+    auto make_graph = [](const String &a_request, const String &b_request = "1")
+    {
+        DependencyGraph g;
+        auto app = g.add(make_package("pvt.app", "1.0.0", 1));
+        auto a = g.add(make_package("pvt.a", "1.0.0", 2));
+        auto b = g.add(make_package("pvt.b", "1.0.0", 3));
+        auto foo3 = g.add(make_package("pvt.foo", "1.2.3", 4));
+        auto foo4 = g.add(make_package("pvt.foo", "1.2.4", 5));
+        auto bar = g.add(make_package("pvt.bar", "1.0.0", 6));
+        g[app].flags.set(pfDirectDependency);
+        g[app].dependencies = { a, b };
+        g[a].dependencies = { foo3 };
+        g[b].dependencies = { foo4 };
+        g[foo3].dependencies = { bar };
+        if (!a_request.empty())
+        {
+            g[app].requested_versions = { Version("1"), Version("1") };
+            g[a].requested_versions = { Version(a_request) };
+            g[b].requested_versions = { Version(b_request) };
+        }
+        return g;
+    };
+    Packages direct;
+    direct["pvt.app"] = make_package("pvt.app", "1.0.0");
+
+    auto g = make_graph("1.2");
+    CHECK(g.unify_versions(direct) == 2);
+    CHECK(g.size() == 4);
+    CHECK(!g.find(make_package("pvt.foo", "1.2.3")));
+    CHECK(!g.find(make_package("pvt.bar", "1.0.0")));
+    auto foo = g.find(make_package("pvt.foo", "1.2.4"));
+    REQUIRE(foo);
+    CHECK(g[*g.find(make_package("pvt.a", "1.0.0"))].dependencies == Ids{ *foo });
+    CHECK(g[*g.find(make_package("pvt.b", "1.0.0"))].dependencies == Ids{ *foo });
+    CHECK(g[*foo].dependencies.empty());
+    CHECK(g[*g.find(make_package("pvt.app", "1.0.0"))].flags[pfDirectDependency]);
+
+    // exact request, highest satisfying version is taken
+    g = make_graph("1.2.3");
+    CHECK(g.unify_versions(direct) == 1);
+    CHECK(g.size() == 5);
+    CHECK(!g.find(make_package("pvt.foo", "1.2.4")));
+    CHECK(g.find(make_package("pvt.bar", "1.0.0")));
+
+    // conflicting requests
+    g = make_graph("1.2.3", "1.2.4");
+    CHECK(g.unify_versions(direct) == 0);
+    CHECK(g.size() == 6);
+
+    // unknown requests are exact too
+    g = make_graph("");
+    CHECK(g.unify_versions(direct) == 0);
+    CHECK(g.size() == 6);
+
+    // branches are never replaced
+    g = make_graph("1.2");
+    auto master = g.add(make_package("pvt.foo", "master", 7));
+    auto c = g.add(make_package("pvt.c", "1.0.0", 8));
+    g[c].dependencies = { master };
+    g[c].requested_versions = { Version("master") };
+    auto app = *g.find(make_package("pvt.app", "1.0.0"));
+    g[app].dependencies.push_back(c);
+    g[app].requested_versions.push_back(Version("1"));
+    CHECK(g.unify_versions(direct) == 0);
+    CHECK(g.size() == 8);
+}
+
+int main(int argc, char **argv)
+{
+    auto rc = Catch::Session().run(argc, argv);
+    return rc;
+}
@@ -0,0 +1,83 @@
+#include <hash.h>
+
+#include <algorithm>
+
+#define CATCH_CONFIG_RUNNER
+#define CATCH_CONFIG_ENABLE_BENCHMARKING
+#include <catch2/catch.hpp>
+
+path make_file(const path &fn, size_t size)
+{
+    String s(size, 0);
+    for (size_t i = 0; i < size; i++)
+        s[i] = (char)(i * 31 + i / 4096);
+    fs::create_directories(fn.parent_path());
+    write_file(fn, s);
+    return fn;
+}
+
+TEST_CASE("tree hash", "[hash]")
+{
+    auto dir = fs::temp_directory_path() / "cppan_hash_test" / unique_path();
+
+    // empty, one chunk, several chunks
+    for (size_t size : { 0, 1000, 5 * 1024 * 1024 + 1 })
+    {
+        INFO(size);
+        auto fn = make_file(dir / "f", size);
+        auto h = tree_file_hash(fn);
+        CHECK(h == tree_file_hash(fn));
+        CHECK(check_file_hash(fn, h));
+        // old format is still accepted
+        CHECK(check_file_hash(fn, strong_file_hash(fn)));
+
+        write_file(fn, read_file(fn) + "x");
+        CHECK_FALSE(check_file_hash(fn, h));
+    }
+
+    // streamed
+    auto fn = make_file(dir / "f", 3 * 1024 * 1024);
+    auto s = read_file(fn);
+    TreeHash h;
+    for (size_t i = 0; i < s.size(); i += 100000)
+        h.update(s.data() + i, std::min<size_t>(100000, s.size() - i));
+    CHECK(h.final() == tree_file_hash(fn));
+    CHECK(h.final() == tree_file_hash(make_file(dir / "empty", 0)));
+
+    make_file(dir / "d" / "a" / "1", 10);
+    make_file(dir / "d" / "2", 20);
+    auto m = make_manifest(dir / "d");
+    REQUIRE(m.size() == 2);
+    CHECK(m[0].path == "2");
+    CHECK(m[1].path == "a/1");
+    CHECK(m[1].size == 10);
+    CHECK(m[1].hash == tree_file_hash(dir / "d" / "a" / "1"));
+    CHECK(make_manifest({ "a/1", dir / "d" / "2" }, dir / "d") == m);
+
+    fs::remove_all(dir);
+}
+
+// run with '[benchmark]' argument
+TEST_CASE("throughput", "[.][benchmark]")
+{
+    auto dir = fs::temp_directory_path() / "cppan_hash_test" / unique_path();
+    auto fn = make_file(dir / "f", 256 * 1024 * 1024);
+
+    BENCHMARK("strong_file_hash")
+    {
+        return strong_file_hash(fn);
+    };
+
+    BENCHMARK("tree_file_hash")
+    {
+        return tree_file_hash(fn);
+    };
+
+    fs::remove_all(dir);
+}
+
+int main(int argc, char **argv)
+{
+    auto rc = Catch::Session().run(argc, argv);
+    return rc;
+}
@@ -0,0 +1,48 @@
+#include <inline_config.h>
+
+#define CATCH_CONFIG_RUNNER
+#include <catch2/catch.hpp>
+
+Strings extract(const String &s)
+{
+    return extract_inline_configs(s.data(), s.data() + s.size());
+}
+
+TEST_CASE("leading comments", "[inline_config]")
+{
+    CHECK(extract("").empty());
+    CHECK(extract("int main() {}\n/* a */").empty());
+
+    auto c = extract(
+        "\xEF\xBB\xBF// license\n"
+        "/* copyright */\n"
+        "#include <a.h>\n"
+        "  /*\n* x\n */\n"
+        "int a; /* b */\n");
+    REQUIRE(c.size() == 2);
+    CHECK(c[0] == " copyright ");
+    CHECK(c[1] == "\n* x\n ");
+
+    // unterminated
+    CHECK(extract("/* a */ /* b").size() == 1);
+}
+
+TEST_CASE("stop at config", "[inline_config]")
+{
+    auto c = extract(
+        "/* license */\n"
+        "/*\n"
+        "dependencies:\n"
+        "    pvt.cppan.demo.sqlite3: 3\n"
+        "*/\n"
+        "/* local_settings: {} */\n");
+    REQUIRE(c.size() == 2);
+    CHECK(c[0] == " license ");
+    CHECK(is_inline_config(load_yaml_config(c[1])));
+}
+
+int main(int argc, char **argv)
+{
+    auto rc = Catch::Session().run(argc, argv);
+    return rc;
+}
@@ -0,0 +1,137 @@
+#include <package.h>
+
+#include <primitives/hash.h>
+
+#define CATCH_CONFIG_RUNNER
+#define CATCH_CONFIG_ENABLE_BENCHMARKING
+#include <catch2/catch.hpp>
+
+Package make_package(const String &ppath, const String &version)
+{
+    Package p;
+    p.ppath = ppath;
+    p.version = version;
+    return p;
+}
+
+std::vector<Package> make_packages(int n)
+{
+    std::vector<Package> v;
+    for (int i = 0; i < n; i++)
+        v.push_back(make_package("pvt.cppan.demo.org" + std::to_string(i % 100) + ".lib" + std::to_string(i), "1.0." + std::to_string(i % 7)));
+    return v;
+}
+
+TEST_CASE("interning", "[package_id]")
+{
+    auto p1 = make_package("pvt.cppan.demo.madler.zlib", "1.2.11");
+    auto p2 = make_package("pvt.cppan.demo.madler.zlib", "1.2.10");
+
+    auto id1 = getPackageId(p1);
+    auto id2 = getPackageId(p2);
+    CHECK(id1 != id2);
+    CHECK(getPackageId(p1) == id1);
+    CHECK(getNumberOfPackageIds() >= 2);
+
+    // flags are not a part of the identity
+    auto p3 = p1;
+    p3.flags.set(pfDirectDependency);
+    CHECK(getPackageId(p3) == id1);
+
+    // interned packages have names
+    auto &ip = getPackage(id1);
+    CHECK(ip == p1);
+    CHECK(ip.target_name == "pvt.cppan.demo.madler.zlib-1.2.11");
+    CHECK(!ip.flags[pfDirectDependency]);
+
+    CHECK_THROWS(getPackage((PackageId)getNumberOfPackageIds()));
+}
+
+TEST_CASE("derived names", "[package_id]")
+{
+    auto p = make_package("pvt.cppan.demo.madler.zlib", "1.2.11");
+    auto h = sha256("pvt.cppan.demo.madler.zlib/1.2.11");
+
+    // not created names are taken from the interner
+    CHECK(p.target_name.empty());
+    CHECK(p.getHash() == h);
+    CHECK(p.getHashShort() == shorten_hash(h, 8));
+    CHECK(p.getHashPath() == path(h.substr(0, 2)) / h.substr(2, 2) / h.substr(4, 4));
+    CHECK(p.getTargetName() == "pvt.cppan.demo.madler.zlib-1.2.11");
+
+    p.createNames();
+    CHECK(p.target_name == "pvt.cppan.demo.madler.zlib-1.2.11");
+    CHECK(p.variable_name == "pvt_cppan_demo_madler_zlib_1_2_11");
+    CHECK(p.target_name_hash == shorten_hash(h, 8));
+    CHECK(p.getHash() == h);
+
+    // names follow the identity
+    p.version = Version("1.2.10");
+    p.createNames();
+    CHECK(p.target_name == "pvt.cppan.demo.madler.zlib-1.2.10");
+    CHECK(p.getHash() == sha256("pvt.cppan.demo.madler.zlib/1.2.10"));
+}
+
+// run with '[benchmark]' argument
+TEST_CASE("graph", "[.][benchmark]")
+{
+    // 5000 packages, 10 dependencies each
+    const int n = 5000;
+    auto nodes = make_packages(n);
+    for (auto &p : nodes)
+        p.createNames();
+
+    BENCHMARK("Package keys")
+    {
+        std::unordered_map<Package, std::vector<Package>> g;
+        for (int i = 0; i < n; i++)
+        {
+            auto &deps = g[nodes[i]];
+            for (int j = 0; j < 10; j++)
+                deps.push_back(nodes[(i * 31 + j * 97) % n]);
+        }
+        return g.size();
+    };
+
+    BENCHMARK("PackageId keys")
+    {
+        std::unordered_map<PackageId, std::vector<PackageId>> g;
+        for (int i = 0; i < n; i++)
+        {
+            auto &deps = g[getPackageId(nodes[i])];
+            for (int j = 0; j < 10; j++)
+                deps.push_back(getPackageId(nodes[(i * 31 + j * 97) % n]));
+        }
+        return g.size();
+    };
+}
+
+// accessors that printers call several times per package per file
+TEST_CASE("names", "[.][benchmark]")
+{
+    auto nodes = make_packages(5000);
+    for (auto &p : nodes)
+        p.createNames();
+
+    BENCHMARK("sha256 on every call")
+    {
+        size_t n = 0;
+        for (auto &p : nodes)
+            n += shorten_hash(sha256(p.ppath.toString() + "/" + p.version.toString()), 8).size();
+        return n;
+    };
+
+    BENCHMARK("memoized")
+    {
+        size_t n = 0;
+        for (auto &p : nodes)
+            n += p.getHashShort().size();
+        return n;
+    };
+}
+
+int main(int argc, char **argv)
+{
+    auto rc = Catch::Session().run(argc, argv);
+    return rc;
+}
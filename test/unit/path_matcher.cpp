@@ -0,0 +1,117 @@
+#include <path_matcher.h>
+
+#include <algorithm>
+#include <regex>
+
+#define CATCH_CONFIG_RUNNER
+#define CATCH_CONFIG_ENABLE_BENCHMARKING
+#include <catch2/catch.hpp>
+
+const std::set<String> patterns
+{
+    "include/.*",
+    "src/.*\\.cpp",
+    "[^/]*\\.h",
+    "docs/[^/]*",
+    "a\\+b/x.h",
+    "x/y/z.c",
+    "lib[0-9]/.*",
+    "ab*c/.*",
+};
+
+const std::vector<String> paths
+{
+    "include/a.h", "include/x/y.h", "src/a.cpp", "src/d/a.cpp", "src/a.h", "a.h", "d/a.h",
+    "a+b/x.h", "ab/x.h", "lib1/q", "libx/q", "ac/q", "abbc/q", "abc", "docs/r", "docs/r/s",
+    "x/y/z.c", "x/y/z.cc", "y/z.c",
+};
+
+TEST_CASE("match", "[path_matcher]")
+{
+    PathMatcher m(patterns);
+    for (auto &p : paths)
+    {
+        bool r = std::any_of(patterns.begin(), patterns.end(), [&p](auto &e)
+        {
+            return std::regex_match(p, std::regex(e));
+        });
+        INFO(p);
+        CHECK(m.match(p) == r);
+    }
+}
+
+TEST_CASE("dirs", "[path_matcher]")
+{
+    PathMatcher m(patterns);
+
+    CHECK(m.match_below("include"));
+    CHECK(m.match_below("include/x"));
+    CHECK(m.match_below("src/d"));
+    CHECK(m.match_below("docs"));
+    CHECK(m.match_below("x/y"));
+    CHECK(m.match_below("ac"));
+    CHECK_FALSE(m.match_below("d"));
+    CHECK_FALSE(m.match_below("docs/r"));
+    CHECK_FALSE(m.match_below("x/y/q"));
+    CHECK_FALSE(m.match_below("tests"));
+
+    CHECK(m.match_all_below("include"));
+    CHECK(m.match_all_below("include/x"));
+    CHECK_FALSE(m.match_all_below("src"));
+
+    // alternation disables pruning
+    PathMatcher m2({ "foo|bar/.*" });
+    CHECK(m2.match_below("tests"));
+}
+
+// run with '[benchmark]' argument
+TEST_CASE("find sources", "[.][benchmark]")
+{
+    // paths of a 200k-file tree: 20 modules x 4 dirs x 50 subdirs x 50 files
+    std::vector<String> files;
+    for (int m = 0; m < 20; m++)
+    {
+        for (String d : { "include", "src", "test", "doc" })
+        {
+            for (int s = 0; s < 50; s++)
+            {
+                for (int f = 0; f < 50; f++)
+                {
+                    files.push_back("module" + std::to_string(m) + "/" + d + "/sub" + std::to_string(s) +
+                        "/file" + std::to_string(f) + (d == "src" ? ".cpp" : ".h"));
+                }
+            }
+        }
+    }
+
+    std::set<String> sources;
+    for (int m = 0; m < 20; m += 2)
+    {
+        sources.insert("module" + std::to_string(m) + "/include/.*");
+        sources.insert("module" + std::to_string(m) + "/src/.*\\.cpp");
+    }
+
+    BENCHMARK("regex")
+    {
+        std::vector<std::regex> rgxs(sources.begin(), sources.end());
+        size_t n = 0;
+        for (auto &f : files)
+            n += std::any_of(rgxs.begin(), rgxs.end(), [&f](auto &r) { return std::regex_match(f, r); });
+        return n;
+    };
+
+    BENCHMARK("path matcher")
+    {
+        PathMatcher m(sources);
+        size_t n = 0;
+        for (auto &f : files)
+            n += m.match(f);
+        return n;
+    };
+}
+
+int main(int argc, char **argv)
+{
+    auto rc = Catch::Session().run(argc, argv);
+    return rc;
+}
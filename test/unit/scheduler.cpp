@@ -0,0 +1,129 @@
+#include <scheduler.h>
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#define CATCH_CONFIG_RUNNER
+#include <catch2/catch.hpp>
+
+TEST_CASE("nested groups", "[scheduler]")
+{
+    // all workers wait in nested groups, waiting threads must run tasks
+    std::atomic<int> n{ 0 };
+    TaskGroup g(Scheduler::Io);
+    for (int i = 0; i < 20; i++)
+    {
+        g.push([&n]
+        {
+            TaskGroup g2;
+            for (int j = 0; j < 20; j++)
+            {
+                g2.push([&n]
+                {
+                    TaskGroup g3(Scheduler::Cpu, Scheduler::High, 1);
+                    for (int k = 0; k < 10; k++)
+                        g3.push([&n] { n++; });
+                    g3.wait();
+                });
+            }
+            g2.wait();
+        });
+    }
+    g.wait();
+    CHECK(n == 4000);
+}
+
+TEST_CASE("wait under lock", "[scheduler]")
+{
+    // waiting thread must not run tasks of other groups,
+    // they would take the same (non recursive) lock again
+    std::mutex m;
+    std::atomic<int> n{ 0 };
+    std::atomic_bool reentered{ false };
+    thread_local bool locked = false;
+    TaskGroup g(Scheduler::Io);
+    for (int i = 0; i < 50; i++)
+    {
+        g.push([&]
+        {
+            if (locked)
+            {
+                reentered = true;
+                return;
+            }
+            std::unique_lock<std::mutex> lk(m);
+            locked = true;
+            TaskGroup g2(Scheduler::Io);
+            for (int j = 0; j < 10; j++)
+                g2.push([&n] { n++; });
+            g2.wait();
+            locked = false;
+        });
+    }
+    g.wait();
+    CHECK(!reentered);
+    CHECK(n == 500);
+}
+
+TEST_CASE("max parallel", "[scheduler]")
+{
+    std::atomic<int> running{ 0 };
+    std::atomic<int> max_running{ 0 };
+    TaskGroup g(Scheduler::Io, Scheduler::Normal, 2);
+    for (int i = 0; i < 50; i++)
+    {
+        g.push([&running, &max_running]
+        {
+            int r = ++running;
+            int m = max_running;
+            while (r > m && !max_running.compare_exchange_weak(m, r))
+                ;
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+            running--;
+        });
+    }
+    g.wait();
+    CHECK(max_running <= 2);
+}
+
+TEST_CASE("errors", "[scheduler]")
+{
+    TaskGroup g;
+    std::atomic<int> n{ 0 };
+    for (int i = 0; i < 10; i++)
+    {
+        g.push([&n, i]
+        {
+            n++;
+            if (i == 5)
+                throw std::runtime_error("task error");
+        });
+    }
+    CHECK_THROWS_AS(g.wait(), std::runtime_error);
+    CHECK(n == 10);
+    CHECK_NOTHROW(g.wait());
+
+    std::vector<int> v(100000);
+    parallel_for(v.size(), [&v](size_t i) { v[i] = (int)i; });
+    for (size_t i = 0; i < v.size(); i++)
+        REQUIRE(v[i] == (int)i);
+
+    CHECK_THROWS_AS(parallel_for(100, [](size_t i)
+    {
+        if (i == 50)
+            throw std::runtime_error("task error");
+    }), std::runtime_error);
+}
+
+int main(int argc, char **argv)
+{
+    Scheduler s(4, 8);
+    getScheduler(&s);
+
+    auto rc = Catch::Session().run(argc, argv);
+    return rc;
+}
@@ -0,0 +1,73 @@
+#include <settings.h>
+
+#include <cstdlib>
+
+#define CATCH_CONFIG_RUNNER
+#include <catch2/catch.hpp>
+
+TEST_CASE("hash", "[settings]")
+{
+#ifdef _WIN32
+    _putenv_s("CC", "");
+#else
+    unsetenv("CC");
+#endif
+
+    Settings s;
+    auto h1 = s.get_hash();
+    CHECK(s.get_hash() == h1);
+
+    // env from settings is hashed, but not applied
+    s.env["CC"] = "clang";
+    auto h2 = s.get_hash();
+    CHECK(h2 != h1);
+    CHECK(getenv("CC") == nullptr);
+
+    s.env.clear();
+    CHECK(s.get_hash() == h1);
+
+    s.c_compiler = "gcc";
+    CHECK(s.get_hash() != h1);
+
+    s.env["CC"] = "clang";
+    auto h3 = s.get_hash();
+    s.apply_env();
+    REQUIRE(getenv("CC") != nullptr);
+    CHECK(getenv("CC") == String("clang"));
+    CHECK(s.get_hash() == h3);
+}
+
+TEST_CASE("snapshot", "[settings]")
+{
+    Settings s;
+    s.c_compiler = "gcc";
+    s.cxx_compiler_flags_conf[Settings::Debug] = "-O0";
+    s.env["CFLAGS"] = "-g";
+    s.cmake_options = { "-DA=1" };
+    s.use_shared_libs = false;
+    s.build_warning_level = 3;
+    s.proxy.host = "localhost:3128";
+    auto h = s.get_hash();
+
+    auto data = serialize_settings(s);
+    Settings s2;
+    deserialize_settings(s2, data);
+
+    CHECK(serialize_settings(s2) == data);
+    CHECK(s2.c_compiler == "gcc");
+    CHECK(s2.cxx_compiler_flags_conf[Settings::Debug] == "-O0");
+    CHECK(s2.env["CFLAGS"] == "-g");
+    CHECK(s2.use_shared_libs == false);
+    CHECK(s2.build_warning_level == 3);
+    CHECK(s2.proxy.host == "localhost:3128");
+    CHECK(s2.get_hash() == h);
+
+    data.pop_back();
+    CHECK_THROWS(deserialize_settings(s2, data));
+}
+
+int main(int argc, char **argv)
+{
+    auto rc = Catch::Session().run(argc, argv);
+    return rc;
+}
@@ -0,0 +1,124 @@
+#include <version.h>
+
+#include <regex>
+
+#define CATCH_CONFIG_RUNNER
+#define CATCH_CONFIG_ENABLE_BENCHMARKING
+#include <catch2/catch.hpp>
+
+TEST_CASE("parse", "[version]")
+{
+    CHECK(Version("*").type == VersionType::Any);
+    CHECK(Version("=").type == VersionType::Equal);
+
+    Version v("1.2.3");
+    CHECK(v.type == VersionType::Version);
+    CHECK(std::tie(v.major, v.minor, v.patch) == std::make_tuple(1, 2, 3));
+    CHECK(Version("1.2") == Version(1, 2));
+    CHECK(Version("1") == Version(1));
+    CHECK(Version("010.0.0") == Version(10, 0, 0));
+    CHECK(Version("0.0.1") == Version(0, 0, 1));
+
+    Version b("master");
+    CHECK(b.type == VersionType::Branch);
+    CHECK(b.branch == "master");
+    CHECK(Version("_feature-1_x").isBranch());
+
+    for (auto s : { "", "0.0.0", "1.", ".1", "1..2", "1.2.3.4", "1.2a", "1a", "-1", "a.b", "a b", "2147483648", "*1", "master!" })
+    {
+        INFO(s);
+        CHECK_THROWS(Version(s));
+    }
+
+    CHECK(Version::check_branch_name("master"));
+    CHECK(!Version::check_branch_name("1master"));
+    CHECK(!Version::check_branch_name("ma.ster"));
+}
+
+TEST_CASE("compare", "[version]")
+{
+    CHECK(Version("1.2.3") < Version("1.2.4"));
+    CHECK(Version("1.2.3") < Version("1.3.0"));
+    CHECK(Version("1.2.3") < Version("2.0.0"));
+    CHECK(Version("1.2") < Version("1.2.0"));
+    CHECK(!(Version("1.2.3") < Version("1.2.3")));
+    CHECK(!(Version("2.0.0") < Version("1.9.9")));
+
+    // branches go first
+    CHECK(Version("master") < Version("0.0.1"));
+    CHECK(!(Version("0.0.1") < Version("master")));
+    CHECK(Version("dev") < Version("master"));
+
+    CHECK(Version("master") == Version("master"));
+    CHECK(Version("master") != Version("dev"));
+    CHECK(Version("master") != Version(1, 2, 3));
+    CHECK(Version() != Version("master"));
+}
+
+TEST_CASE("canBe", "[version]")
+{
+    CHECK(Version().canBe(Version(1, 2, 3)));
+    CHECK(Version(1).canBe(Version(1, 2, 3)));
+    CHECK(Version(1, 2).canBe(Version(1, 2, 3)));
+    CHECK(Version(1, 2, 3).canBe(Version(1, 2, 3)));
+    CHECK(!Version(1, 2, 3).canBe(Version(1, 2, 4)));
+    CHECK(!Version(1, 3).canBe(Version(1, 2, 3)));
+    CHECK(!Version(2).canBe(Version(1, 2, 3)));
+    CHECK(Version("master").canBe(Version("master")));
+}
+
+// run with '[benchmark]' argument
+TEST_CASE("throughput", "[.][benchmark]")
+{
+    Strings strings;
+    for (int i = 0; i < 10000; i++)
+    {
+        auto n = std::to_string(i % 10 + 1);
+        Strings v{ n, n + "." + std::to_string(i % 20), n + "." + std::to_string(i % 20) + "." + std::to_string(i % 100), "master" };
+        strings.push_back(v[i % 4]);
+    }
+
+    // expressions of the previous parser
+    const std::regex r_branch_name(R"(([a-zA-Z_][a-zA-Z0-9_-]*))");
+    const std::regex r_version1(R"((\d+))");
+    const std::regex r_version2(R"((\d+)\.(\d+))");
+    const std::regex r_version3(R"((\d+)\.(\d+)\.(\d+))");
+
+    BENCHMARK("parse with regex")
+    {
+        size_t n = 0;
+        for (auto &s : strings)
+        {
+            std::smatch m;
+            n += std::regex_match(s, m, r_version3) || std::regex_match(s, m, r_version2) ||
+                std::regex_match(s, m, r_version1) || std::regex_match(s, m, r_branch_name);
+        }
+        return n;
+    };
+
+    BENCHMARK("parse")
+    {
+        size_t n = 0;
+        for (auto &s : strings)
+            n += Version(s).isBranch();
+        return n;
+    };
+
+    std::vector<Version> versions(strings.begin(), strings.begin() + 1000);
+    BENCHMARK("canBe + operator<")
+    {
+        size_t n = 0;
+        for (auto &r : versions)
+        {
+            for (auto &v : versions)
+                n += r.canBe(v) + (r < v);
+        }
+        return n;
+    };
+}
+
+int main(int argc, char **argv)
+{
+    auto rc = Catch::Session().run(argc, argv);
+    return rc;
+}